@@ -0,0 +1,449 @@
+#pragma once
+
+// Std. Includes
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+
+// One node of the flattened tree, 32 bytes so two share a cache line. Nodes are stored depth first: an
+// interior node's left child directly follows it and Offset is its right child, a leaf covers Count objects
+// starting at Offset in the object order.
+struct BVHNode
+{
+    glm::vec3 Min;
+    GLuint Offset;
+    glm::vec3 Max;
+    GLuint Count; // 0 for interior nodes
+};
+
+// Bounding volume hierarchy over the boxes of a BoundsArray, built with the surface area heuristic over binned
+// centroids. Answers frustum, ray and overlap queries in about O(log n) per result instead of testing every box.
+// Empty boxes (objects without geometry) are left out. When objects move, Update() refits the nodes above one
+// object and Refit() all of them; the tree keeps its topology, so rebuild after large changes.
+class BVH
+{
+public:
+    // Leaves hold at most this many objects
+    static const GLuint MAX_LEAF_SIZE = 4;
+    // Centroid bins tried per split
+    static const int BINS = 12;
+    // Traversal stack depth, the SAH keeps trees far shallower than this
+    static const int MAX_DEPTH = 64;
+
+    void Build(const BoundsArray& bounds)
+    {
+        this->nodes.clear();
+        this->objects.clear();
+        this->boxes.resize(bounds.Size());
+        for (size_t i = 0; i < bounds.Size(); ++i)
+        {
+            this->boxes[i] = bounds.Get(i);
+            if (!this->boxes[i].Empty())
+                this->objects.push_back((GLuint)i);
+        }
+        this->parents.clear();
+        this->leafOf.assign(bounds.Size(), INVALID);
+        if (this->objects.empty())
+            return;
+
+        this->nodes.reserve(2 * this->objects.size());
+        this->build(0, (GLuint)this->objects.size(), INVALID, 0);
+    }
+
+    size_t NodeCount() const
+    {
+        return this->nodes.size();
+    }
+
+    // Number of objects in the tree
+    size_t Size() const
+    {
+        return this->objects.size();
+    }
+
+    // Changes the box of one object and grows or shrinks every node above it
+    void Update(size_t object, const AABB& box)
+    {
+        this->boxes[object] = box;
+        for (GLuint node = this->leafOf[object]; node != INVALID; node = this->parents[node])
+            this->fit(node);
+    }
+
+    // Recomputes every node from new boxes, children come after their parent so one backwards pass suffices
+    void Refit(const BoundsArray& bounds)
+    {
+        for (GLuint object : this->objects)
+            this->boxes[object] = bounds.Get(object);
+        for (size_t node = this->nodes.size(); node-- > 0;)
+            this->fit((GLuint)node);
+    }
+
+    // Same contract as BoundsArray::CullFrustum: visible[i] is 1 for every object at least partly inside the 6
+    // planes and 0 otherwise (also for objects left out of the tree). Nodes found entirely inside a plane skip
+    // that plane for their whole subtree. Returns the number of visible objects.
+    size_t CullFrustum(const glm::vec4* planes, std::vector<GLubyte>& visible) const
+    {
+        visible.assign(this->boxes.size(), 0);
+        if (this->nodes.empty())
+            return 0;
+
+        size_t count = 0;
+        // Node index and the planes its subtree still has to be tested against, one bit each
+        GLuint stack[MAX_DEPTH][2];
+        int top = 0;
+        stack[top][0] = 0;
+        stack[top][1] = 0x3F;
+        top++;
+        while (top > 0)
+        {
+            --top;
+            GLuint index = stack[top][0];
+            const BVHNode& node = this->nodes[index];
+            GLuint planeMask = stack[top][1];
+            if (!classify(node.Min, node.Max, planes, planeMask))
+                continue;
+
+            if (planeMask == 0)
+            {
+                // Entirely inside: everything under the node is visible
+                GLuint first, last;
+                this->objectRange(index, first, last);
+                for (GLuint i = first; i < last; ++i)
+                    visible[this->objects[i]] = 1;
+                count += last - first;
+                continue;
+            }
+            if (node.Count > 0)
+            {
+                for (GLuint i = node.Offset; i < node.Offset + node.Count; ++i)
+                {
+                    const AABB& box = this->boxes[this->objects[i]];
+                    GLuint objectMask = planeMask;
+                    if (classify(box.Min, box.Max, planes, objectMask))
+                    {
+                        visible[this->objects[i]] = 1;
+                        count++;
+                    }
+                }
+                continue;
+            }
+            stack[top][0] = node.Offset;  stack[top][1] = planeMask; top++;
+            stack[top][0] = index + 1;    stack[top][1] = planeMask; top++;
+        }
+        return count;
+    }
+
+    // Casts a ray and returns the closest object hit, or -1. The boxes are only the broadphase: hitObject(object,
+    // closest) is called for every object whose box the ray enters before closest, and returns the distance along
+    // the ray of its real hit, or a negative value on a miss. Nodes are visited near to far, so the search stops
+    // early. distance returns the closest hit.
+    template <typename HitFunction>
+    GLint Raycast(const glm::vec3& origin, const glm::vec3& direction, GLfloat maxDistance, GLfloat& distance,
+                  HitFunction hitObject) const
+    {
+        GLint closestObject = -1;
+        distance = maxDistance;
+        if (this->nodes.empty())
+            return -1;
+
+        glm::vec3 inverse = 1.0f / direction;
+        GLuint stack[MAX_DEPTH];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const BVHNode& node = this->nodes[stack[--top]];
+            GLfloat entry;
+            if (!intersectRay(node.Min, node.Max, origin, inverse, distance, entry))
+                continue;
+
+            if (node.Count > 0)
+            {
+                for (GLuint i = node.Offset; i < node.Offset + node.Count; ++i)
+                {
+                    GLuint object = this->objects[i];
+                    if (!intersectRay(this->boxes[object].Min, this->boxes[object].Max, origin, inverse, distance, entry))
+                        continue;
+                    GLfloat hit = hitObject(object, distance);
+                    if (hit >= 0.0f && hit < distance)
+                    {
+                        distance = hit;
+                        closestObject = (GLint)object;
+                    }
+                }
+                continue;
+            }
+
+            // Push the further child first so the nearer one is visited next
+            GLuint left = (GLuint)(&node - this->nodes.data()) + 1;
+            GLuint right = node.Offset;
+            GLfloat leftEntry, rightEntry;
+            bool hitLeft = intersectRay(this->nodes[left].Min, this->nodes[left].Max, origin, inverse, distance, leftEntry);
+            bool hitRight = intersectRay(this->nodes[right].Min, this->nodes[right].Max, origin, inverse, distance, rightEntry);
+            if (hitLeft && hitRight)
+            {
+                if (leftEntry < rightEntry)
+                    std::swap(left, right);
+                stack[top++] = left;
+                stack[top++] = right;
+            }
+            else if (hitLeft)
+                stack[top++] = left;
+            else if (hitRight)
+                stack[top++] = right;
+        }
+        return closestObject;
+    }
+
+    // Ray cast against the boxes only, the distance where the ray enters a box counts as its hit
+    GLint Raycast(const glm::vec3& origin, const glm::vec3& direction, GLfloat maxDistance, GLfloat& distance) const
+    {
+        return this->Raycast(origin, direction, maxDistance, distance, [&](GLuint object, GLfloat closest) {
+            GLfloat entry;
+            glm::vec3 inverse = 1.0f / direction;
+            return intersectRay(this->boxes[object].Min, this->boxes[object].Max, origin, inverse, closest, entry) ? entry : -1.0f;
+        });
+    }
+
+    // Appends every object whose box overlaps box to result
+    void Overlap(const AABB& box, std::vector<GLuint>& result) const
+    {
+        if (this->nodes.empty())
+            return;
+
+        GLuint stack[MAX_DEPTH];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            GLuint index = stack[--top];
+            const BVHNode& node = this->nodes[index];
+            if (!overlaps(node.Min, node.Max, box))
+                continue;
+            if (node.Count == 0)
+            {
+                stack[top++] = node.Offset;
+                stack[top++] = index + 1;
+                continue;
+            }
+            for (GLuint i = node.Offset; i < node.Offset + node.Count; ++i)
+            {
+                if (overlaps(this->boxes[this->objects[i]].Min, this->boxes[this->objects[i]].Max, box))
+                    result.push_back(this->objects[i]);
+            }
+        }
+    }
+
+private:
+    static constexpr GLuint INVALID = 0xFFFFFFFFu;
+
+    std::vector<BVHNode> nodes;
+    // Object indices in leaf order, every leaf covers a contiguous run
+    std::vector<GLuint> objects;
+    // Box of every object by object index
+    std::vector<AABB> boxes;
+    // Parent of every node and leaf of every object, INVALID for the root and objects outside the tree
+    std::vector<GLuint> parents;
+    std::vector<GLuint> leafOf;
+
+    // Tests a box against the planes set in planeMask. Returns false when it is entirely outside one of them,
+    // otherwise clears the bits of the planes it is entirely inside of.
+    static bool classify(const glm::vec3& min, const glm::vec3& max, const glm::vec4* planes, GLuint& planeMask)
+    {
+        for (int p = 0; p < 6; ++p)
+        {
+            if (!(planeMask & (1u << p)))
+                continue;
+            const glm::vec4& plane = planes[p];
+            // Corner furthest along the normal decides outside, the nearest one fully inside
+            glm::vec3 farCorner(plane.x >= 0.0f ? max.x : min.x,
+                                plane.y >= 0.0f ? max.y : min.y,
+                                plane.z >= 0.0f ? max.z : min.z);
+            glm::vec3 nearCorner(plane.x >= 0.0f ? min.x : max.x,
+                                 plane.y >= 0.0f ? min.y : max.y,
+                                 plane.z >= 0.0f ? min.z : max.z);
+            if (glm::dot(glm::vec3(plane), farCorner) + plane.w < 0.0f)
+                return false;
+            if (glm::dot(glm::vec3(plane), nearCorner) + plane.w >= 0.0f)
+                planeMask &= ~(1u << p);
+        }
+        return true;
+    }
+
+    static bool overlaps(const glm::vec3& min, const glm::vec3& max, const AABB& box)
+    {
+        return min.x <= box.Max.x && max.x >= box.Min.x &&
+               min.y <= box.Max.y && max.y >= box.Min.y &&
+               min.z <= box.Max.z && max.z >= box.Min.z;
+    }
+
+    // Slab test, entry is where the ray enters the box (0 when it starts inside)
+    static bool intersectRay(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin,
+                             const glm::vec3& inverse, GLfloat maxDistance, GLfloat& entry)
+    {
+        glm::vec3 t0 = (min - origin) * inverse;
+        glm::vec3 t1 = (max - origin) * inverse;
+        glm::vec3 tNear = glm::min(t0, t1);
+        glm::vec3 tFar = glm::max(t0, t1);
+        entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        GLfloat exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+        return entry <= exit;
+    }
+
+    static GLfloat surfaceArea(const AABB& box)
+    {
+        glm::vec3 size = box.Max - box.Min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    // First and one past the last object index below a node
+    void objectRange(GLuint index, GLuint& first, GLuint& last) const
+    {
+        GLuint leftmost = index;
+        while (this->nodes[leftmost].Count == 0)
+            leftmost = leftmost + 1;
+        GLuint rightmost = index;
+        while (this->nodes[rightmost].Count == 0)
+            rightmost = this->nodes[rightmost].Offset;
+        first = this->nodes[leftmost].Offset;
+        last = this->nodes[rightmost].Offset + this->nodes[rightmost].Count;
+    }
+
+    // Recomputes a node's box from its children or objects
+    void fit(GLuint index)
+    {
+        BVHNode& node = this->nodes[index];
+        AABB box;
+        if (node.Count > 0)
+        {
+            for (GLuint i = node.Offset; i < node.Offset + node.Count; ++i)
+                box.Add(this->boxes[this->objects[i]]);
+        }
+        else
+        {
+            const BVHNode& left = this->nodes[index + 1];
+            const BVHNode& right = this->nodes[node.Offset];
+            box.Min = glm::min(left.Min, right.Min);
+            box.Max = glm::max(left.Max, right.Max);
+        }
+        node.Min = box.Min;
+        node.Max = box.Max;
+    }
+
+    // Builds the subtree over objects[first, last) and returns its node index
+    GLuint build(GLuint first, GLuint last, GLuint parent, int depth)
+    {
+        GLuint index = (GLuint)this->nodes.size();
+        this->nodes.push_back(BVHNode());
+        this->parents.push_back(parent);
+
+        AABB box, centroids;
+        for (GLuint i = first; i < last; ++i)
+        {
+            const AABB& object = this->boxes[this->objects[i]];
+            box.Add(object);
+            centroids.Add((object.Min + object.Max) * 0.5f);
+        }
+        this->nodes[index].Min = box.Min;
+        this->nodes[index].Max = box.Max;
+
+        GLuint count = last - first;
+        GLuint split = first;
+        if (depth >= MAX_DEPTH / 2)
+        {
+            // Far deeper than the SAH normally goes: halve by count so the traversal stacks can't overflow
+            if (count > MAX_LEAF_SIZE)
+                split = first + count / 2;
+        }
+        else if (count > 1)
+            split = this->findSplit(first, last, box, centroids);
+        if (split == first)
+        {
+            this->nodes[index].Offset = first;
+            this->nodes[index].Count = count;
+            for (GLuint i = first; i < last; ++i)
+                this->leafOf[this->objects[i]] = index;
+            return index;
+        }
+
+        this->nodes[index].Count = 0;
+        this->build(first, split, index, depth + 1);
+        GLuint right = this->build(split, last, index, depth + 1);
+        this->nodes[index].Offset = right;
+        return index;
+    }
+
+    // Partitions objects[first, last) at the cheapest binned SAH split and returns the first index of the right
+    // half, or first when keeping a leaf is cheaper (only allowed up to MAX_LEAF_SIZE objects)
+    GLuint findSplit(GLuint first, GLuint last, const AABB& box, const AABB& centroids)
+    {
+        GLuint count = last - first;
+        glm::vec3 extent = centroids.Max - centroids.Min;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        if (extent[axis] <= 0.0f)
+        {
+            // Every centroid in the same spot, split by count so oversized leaves can't happen
+            return count > MAX_LEAF_SIZE ? first + count / 2 : first;
+        }
+
+        struct Bin
+        {
+            AABB Box;
+            GLuint Count = 0;
+        };
+        Bin bins[BINS];
+        GLfloat scale = BINS / extent[axis];
+        auto binOf = [&](GLuint object) {
+            GLfloat centroid = (this->boxes[object].Min[axis] + this->boxes[object].Max[axis]) * 0.5f;
+            return std::min(BINS - 1, (int)((centroid - centroids.Min[axis]) * scale));
+        };
+        for (GLuint i = first; i < last; ++i)
+        {
+            Bin& bin = bins[binOf(this->objects[i])];
+            bin.Box.Add(this->boxes[this->objects[i]]);
+            bin.Count++;
+        }
+
+        // Cost of splitting after every bin: area of each side times the objects in it, swept from both ends
+        GLfloat rightCost[BINS - 1];
+        AABB sweep;
+        GLuint sweepCount = 0;
+        for (int b = BINS - 1; b > 0; --b)
+        {
+            sweep.Add(bins[b].Box);
+            sweepCount += bins[b].Count;
+            rightCost[b - 1] = sweepCount ? surfaceArea(sweep) * sweepCount : 0.0f;
+        }
+        int bestSplit = -1;
+        GLfloat bestCost = std::numeric_limits<GLfloat>::max();
+        sweep = AABB();
+        sweepCount = 0;
+        for (int b = 0; b < BINS - 1; ++b)
+        {
+            sweep.Add(bins[b].Box);
+            sweepCount += bins[b].Count;
+            GLfloat cost = (sweepCount ? surfaceArea(sweep) * sweepCount : 0.0f) + rightCost[b];
+            if (sweepCount > 0 && sweepCount < count && cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = b;
+            }
+        }
+
+        // Traversal costs about as much as one box test, so a leaf wins when the split saves less than that
+        GLfloat leafCost = surfaceArea(box) * count;
+        if (bestSplit < 0 || (count <= MAX_LEAF_SIZE && bestCost + surfaceArea(box) >= leafCost))
+            return count > MAX_LEAF_SIZE ? first + count / 2 : first;
+
+        GLuint* middle = std::partition(this->objects.data() + first, this->objects.data() + last,
+                                        [&](GLuint object) { return binOf(object) <= bestSplit; });
+        return (GLuint)(middle - this->objects.data());
+    }
+};
@@ -0,0 +1,223 @@
+#pragma once
+
+// Std. Includes
+#include <vector>
+
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "GeometryPool.h"
+
+
+// Per-object data as laid out in the std430 Objects buffer of batch.vs
+struct ObjectData
+{
+    glm::mat4 Model;
+    glm::vec4 Color;
+    GLint Layer;      // texture array layer, -1 draws Color
+    GLint Padding[3];
+};
+
+// Command layout read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    GLuint Count;
+    GLuint InstanceCount;
+    GLuint FirstIndex;
+    GLint BaseVertex;
+    GLuint BaseInstance;
+};
+
+// Submits many objects from a GeometryPool with one glMultiDrawElementsIndirect per primitive mode and texturing.
+// Colours, texture layers and model matrices live in a shader storage buffer; each command's base instance selects
+// its object through an instanced vertex attribute (location 2), so the CPU cost per frame doesn't grow with the
+// object count. Textured and solid objects are separate batches, drawn with the TEXTURED and the plain permutation
+// of batch.vs/batch.frag, so the shaders don't branch on it. Textured objects sample the array texture bound to
+// unit 0, so they need no binds between draws.
+// Needs OpenGL 4.3, callers keep a per-draw path for 3.3 contexts.
+class BatchRenderer
+{
+public:
+    // Binding point of the Objects buffer in batch.vs
+    static const GLuint OBJECT_BINDING = 0;
+    // Vertex attribute location of objectIndex in batch.vs
+    static const GLuint OBJECT_INDEX_ATTRIBUTE = 2;
+
+    static bool Supported()
+    {
+        return GLEW_VERSION_4_3;
+    }
+
+    // Queues one object, objects are drawn in the order they're added within their batch.
+    // layer selects the object's texture array layer, -1 draws it in color.
+    void Add(const DrawRange& range, const glm::mat4& model, const glm::vec4& color, GLint layer = -1)
+    {
+        DrawElementsIndirectCommand command;
+        command.Count = (GLuint)range.Count;
+        command.InstanceCount = 1;
+        command.FirstIndex = range.FirstIndex;
+        command.BaseVertex = range.BaseVertex;
+        command.BaseInstance = (GLuint)this->objects.size();
+        this->commands.push_back(command);
+        this->keys.push_back(BatchKey{ range.Mode, layer >= 0 });
+
+        ObjectData object;
+        object.Model = model;
+        object.Color = color;
+        object.Layer = layer;
+        object.Padding[0] = object.Padding[1] = object.Padding[2] = 0;
+        this->objects.push_back(object);
+    }
+
+    // Creates the GL buffers and hooks the object index attribute into the pool's VAO
+    void Upload(const GeometryPool& pool)
+    {
+        // Group the commands by primitive mode and texturing, keeping the order within each group
+        std::vector<DrawElementsIndirectCommand> sorted;
+        this->commandOf.resize(this->objects.size());
+        for (size_t i = 0; i < this->keys.size(); ++i)
+        {
+            bool seen = false;
+            for (const Batch& batch : this->batches)
+                seen = seen || batch.Key == this->keys[i];
+            if (seen)
+                continue;
+
+            Batch batch;
+            batch.Key = this->keys[i];
+            batch.FirstCommand = (GLsizei)sorted.size();
+            for (size_t j = i; j < this->keys.size(); ++j)
+            {
+                if (this->keys[j] == batch.Key)
+                {
+                    this->commandOf[j] = sorted.size();
+                    sorted.push_back(this->commands[j]);
+                }
+            }
+            batch.CommandCount = (GLsizei)sorted.size() - batch.FirstCommand;
+            this->batches.push_back(batch);
+        }
+
+        std::vector<GLuint> objectIndices(this->objects.size());
+        for (size_t i = 0; i < objectIndices.size(); ++i)
+            objectIndices[i] = (GLuint)i;
+
+        glGenBuffers(1, &this->indirectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sorted.size() * sizeof(DrawElementsIndirectCommand), sorted.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        glGenBuffers(1, &this->objectBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->objectBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, this->objects.size() * sizeof(ObjectData), this->objects.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        glGenBuffers(1, &this->objectIndexBuffer);
+        pool.Bind();
+        glBindBuffer(GL_ARRAY_BUFFER, this->objectIndexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, objectIndices.size() * sizeof(GLuint), objectIndices.data(), GL_STATIC_DRAW);
+        glVertexAttribIPointer(OBJECT_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (GLvoid*)0);
+        glVertexAttribDivisor(OBJECT_INDEX_ATTRIBUTE, 1);
+        glEnableVertexAttribArray(OBJECT_INDEX_ATTRIBUTE);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        this->commands.swap(sorted);
+    }
+
+    // Shows or hides one object (index in the order of Add()) from the following draws. Hidden objects keep
+    // their command with an instance count of 0, so the batches never need rebuilding.
+    void SetVisible(size_t object, bool visible)
+    {
+        DrawElementsIndirectCommand& command = this->commands[this->commandOf[object]];
+        GLuint instances = visible ? 1 : 0;
+        if (command.InstanceCount != instances)
+        {
+            command.InstanceCount = instances;
+            this->commandsChanged = true;
+        }
+    }
+
+    // Sends the commands changed by SetVisible() to the indirect buffer, call before drawing
+    void UpdateVisibility()
+    {
+        if (!this->commandsChanged)
+            return;
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->indirectBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, this->commands.size() * sizeof(DrawElementsIndirectCommand), this->commands.data());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        this->commandsChanged = false;
+    }
+
+    // Draws the queued objects with the given primitive mode that are textured or solid. The pool must be bound
+    // and the matching batch shader permutation (TEXTURED or not) in use.
+    void Draw(GLenum mode, bool textured) const
+    {
+        this->Draw(mode, textured, this->indirectBuffer);
+    }
+
+    // Draws from a copy of the commands in another buffer, e.g. one a culling pass wrote
+    void Draw(GLenum mode, bool textured, GLuint commandBuffer) const
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, this->objectBuffer);
+        for (const Batch& batch : this->batches)
+        {
+            if (!(batch.Key == BatchKey{ mode, textured }))
+                continue;
+            glMultiDrawElementsIndirect(batch.Key.Mode, GL_UNSIGNED_SHORT,
+                                        (GLvoid*)(batch.FirstCommand * sizeof(DrawElementsIndirectCommand)),
+                                        batch.CommandCount, 0);
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // Indirect buffer holding the commands, grouped by batch, with hidden objects at an instance count of 0
+    GLuint CommandBuffer() const
+    {
+        return this->indirectBuffer;
+    }
+
+    GLsizei CommandCount() const
+    {
+        return (GLsizei)this->commands.size();
+    }
+
+    void Release()
+    {
+        glDeleteBuffers(1, &this->indirectBuffer);
+        glDeleteBuffers(1, &this->objectBuffer);
+        glDeleteBuffers(1, &this->objectIndexBuffer);
+        this->indirectBuffer = this->objectBuffer = this->objectIndexBuffer = 0;
+    }
+
+private:
+    // What the commands of one batch share
+    struct BatchKey
+    {
+        GLenum Mode;
+        bool Textured;
+
+        bool operator==(const BatchKey& other) const
+        {
+            return this->Mode == other.Mode && this->Textured == other.Textured;
+        }
+    };
+
+    // A run of commands sharing one key
+    struct Batch
+    {
+        BatchKey Key;
+        GLsizei FirstCommand;
+        GLsizei CommandCount;
+    };
+
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<BatchKey> keys;
+    std::vector<ObjectData> objects;
+    std::vector<Batch> batches;
+    // Position of every object's command in commands after Upload()
+    std::vector<size_t> commandOf;
+    bool commandsChanged = false;
+    GLuint indirectBuffer = 0, objectBuffer = 0, objectIndexBuffer = 0;
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+// Std. Includes
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+// GL Includes
+#include <GL/glew.h>
+
+
+// Statistics of a list of timings in milliseconds
+struct TimingSummary
+{
+    double Mean = 0.0, P50 = 0.0, P95 = 0.0, P99 = 0.0, Min = 0.0, Max = 0.0;
+
+    static TimingSummary From(std::vector<double> samples)
+    {
+        TimingSummary s;
+        if (samples.empty())
+            return s;
+        std::sort(samples.begin(), samples.end());
+        double total = 0.0;
+        for (double v : samples)
+            total += v;
+        s.Mean = total / samples.size();
+        s.P50 = percentile(samples, 0.50);
+        s.P95 = percentile(samples, 0.95);
+        s.P99 = percentile(samples, 0.99);
+        s.Min = samples.front();
+        s.Max = samples.back();
+        return s;
+    }
+
+    std::string ToJSON() const
+    {
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer),
+                 "{ \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f }",
+                 this->Mean, this->P50, this->P95, this->P99, this->Min, this->Max);
+        return buffer;
+    }
+
+private:
+    // Nearest-rank percentile of sorted samples
+    static double percentile(const std::vector<double>& sorted, double p)
+    {
+        size_t rank = (size_t)(p * sorted.size() + 0.5);
+        rank = std::min(std::max(rank, (size_t)1), sorted.size());
+        return sorted[rank - 1];
+    }
+};
+
+// Records frame time, CPU submit time and GPU time (GL_TIME_ELAPSED) for every frame of a benchmark run.
+// GPU results are read QUERY_LATENCY frames late so waiting on a query never stalls the pipeline.
+// Per frame call BeginFrame() before submitting, EndSubmit() once every draw is issued, and Finish() after the last frame.
+class Benchmark
+{
+public:
+    static const int QUERY_LATENCY = 4;
+
+    // The first warmupFrames frames are rendered but not recorded
+    explicit Benchmark(int warmupFrames = 10) : warmupFrames(warmupFrames)
+    {
+        glGenQueries(QUERY_LATENCY, this->queries);
+    }
+
+    ~Benchmark()
+    {
+        glDeleteQueries(QUERY_LATENCY, this->queries);
+    }
+
+    void BeginFrame()
+    {
+        Clock::time_point now = Clock::now();
+        if (this->frameIndex > 0 && this->frameIndex - 1 >= this->warmupFrames)
+            this->frameTimes.push_back(milliseconds(now - this->frameStart));
+        this->frameStart = now;
+
+        // The query slot about to be reused belongs to QUERY_LATENCY frames ago
+        if (this->frameIndex >= QUERY_LATENCY)
+            this->readQuery(this->frameIndex - QUERY_LATENCY);
+        glBeginQuery(GL_TIME_ELAPSED, this->queries[this->frameIndex % QUERY_LATENCY]);
+    }
+
+    void EndSubmit()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        if (this->frameIndex >= this->warmupFrames)
+            this->submitTimes.push_back(milliseconds(Clock::now() - this->frameStart));
+        this->frameIndex++;
+    }
+
+    // Closes the last frame and collects the outstanding GPU timings
+    void Finish()
+    {
+        if (this->frameIndex > 0 && this->frameIndex - 1 >= this->warmupFrames)
+            this->frameTimes.push_back(milliseconds(Clock::now() - this->frameStart));
+        for (int frame = std::max(0, this->frameIndex - QUERY_LATENCY); frame < this->frameIndex; ++frame)
+            this->readQuery(frame);
+    }
+
+    // Writes the summary as JSON to path and prints it
+    bool WriteJSON(const std::string& path, const std::string& renderer) const
+    {
+        const GLubyte* glRenderer = glGetString(GL_RENDERER);
+        const GLubyte* glVersion = glGetString(GL_VERSION);
+        std::string json = "{\n";
+        json += "  \"frames\": " + std::to_string(this->frameTimes.size()) + ",\n";
+        json += "  \"warmup_frames\": " + std::to_string(this->warmupFrames) + ",\n";
+        json += "  \"renderer\": \"" + renderer + "\",\n";
+        json += "  \"gl_renderer\": \"" + escape(glRenderer ? (const char*)glRenderer : "") + "\",\n";
+        json += "  \"gl_version\": \"" + escape(glVersion ? (const char*)glVersion : "") + "\",\n";
+        json += "  \"frame_ms\": " + TimingSummary::From(this->frameTimes).ToJSON() + ",\n";
+        json += "  \"cpu_submit_ms\": " + TimingSummary::From(this->submitTimes).ToJSON() + ",\n";
+        json += "  \"gpu_ms\": " + TimingSummary::From(this->gpuTimes).ToJSON() + "\n";
+        json += "}\n";
+
+        std::cout << json;
+        std::ofstream file(path);
+        if (!file.is_open())
+        {
+            std::cout << "ERROR::BENCHMARK::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        file << json;
+        return file.good();
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    int warmupFrames;
+    int frameIndex = 0;
+    Clock::time_point frameStart;
+    GLuint queries[QUERY_LATENCY];
+    std::vector<double> frameTimes, submitTimes, gpuTimes;
+
+    static double milliseconds(Clock::duration d)
+    {
+        return std::chrono::duration<double, std::milli>(d).count();
+    }
+
+    void readQuery(int frame)
+    {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(this->queries[frame % QUERY_LATENCY], GL_QUERY_RESULT, &elapsed);
+        if (frame >= this->warmupFrames)
+            this->gpuTimes.push_back(elapsed / 1.0e6);
+    }
+
+    static std::string escape(const std::string& text)
+    {
+        std::string out;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out;
+    }
+};
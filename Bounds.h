@@ -0,0 +1,169 @@
+#pragma once
+
+// Std. Includes
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// SIMD Includes: 8 boxes per test with AVX, 4 with SSE (always there on x86-64), one at a time otherwise
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BOUNDS_SSE
+#endif
+
+
+// Axis aligned bounding box, empty (Min > Max) until a point is added
+struct AABB
+{
+    glm::vec3 Min = glm::vec3(std::numeric_limits<GLfloat>::max());
+    glm::vec3 Max = glm::vec3(-std::numeric_limits<GLfloat>::max());
+
+    void Add(const glm::vec3& point)
+    {
+        this->Min = glm::min(this->Min, point);
+        this->Max = glm::max(this->Max, point);
+    }
+
+    void Add(const AABB& box)
+    {
+        this->Min = glm::min(this->Min, box.Min);
+        this->Max = glm::max(this->Max, box.Max);
+    }
+
+    bool Empty() const
+    {
+        return this->Min.x > this->Max.x;
+    }
+
+    // Box around the positions of interleaved vertices, the position being the first 3 floats of each
+    static AABB FromVertices(const GLfloat* vertices, size_t vertexCount, GLint floatsPerVertex)
+    {
+        AABB box;
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            const GLfloat* position = vertices + v * floatsPerVertex;
+            box.Add(glm::vec3(position[0], position[1], position[2]));
+        }
+        return box;
+    }
+
+    static AABB FromVertices(const std::vector<GLfloat>& vertices, GLint floatsPerVertex)
+    {
+        return FromVertices(vertices.data(), vertices.size() / floatsPerVertex, floatsPerVertex);
+    }
+};
+
+// Bounding boxes of many objects stored as structure of arrays (one array per min/max component), so a frustum
+// test handles a full SIMD register of boxes per instruction. The arrays are padded to a multiple of LANES.
+class BoundsArray
+{
+public:
+#if defined(__AVX__)
+    static const size_t LANES = 8;
+#elif defined(BOUNDS_SSE)
+    static const size_t LANES = 4;
+#else
+    static const size_t LANES = 1;
+#endif
+
+    // Appends a box and returns its index
+    size_t Add(const AABB& box)
+    {
+        size_t index = this->count++;
+        size_t padded = (this->count + LANES - 1) / LANES * LANES;
+        for (std::vector<GLfloat>* component : { &this->minX, &this->minY, &this->minZ, &this->maxX, &this->maxY, &this->maxZ })
+            component->resize(padded, 0.0f);
+        this->Set(index, box);
+        return index;
+    }
+
+    // Replaces the box of an object that moved
+    void Set(size_t index, const AABB& box)
+    {
+        this->minX[index] = box.Min.x; this->minY[index] = box.Min.y; this->minZ[index] = box.Min.z;
+        this->maxX[index] = box.Max.x; this->maxY[index] = box.Max.y; this->maxZ[index] = box.Max.z;
+    }
+
+    AABB Get(size_t index) const
+    {
+        AABB box;
+        box.Min = glm::vec3(this->minX[index], this->minY[index], this->minZ[index]);
+        box.Max = glm::vec3(this->maxX[index], this->maxY[index], this->maxZ[index]);
+        return box;
+    }
+
+    size_t Size() const
+    {
+        return this->count;
+    }
+
+    // Tests every box against the 6 planes of Camera::GetFrustumPlanes(). visible[i] becomes 1 when box i is
+    // at least partly inside, 0 when it is entirely outside one plane. Returns the number of visible boxes.
+    // Boxes straddling a plane corner can be kept although they are outside, never the other way round.
+    size_t CullFrustum(const glm::vec4* planes, std::vector<GLubyte>& visible) const
+    {
+        visible.resize(this->minX.size());
+        // For every plane only the box corner furthest along its normal matters: if that one is behind the
+        // plane the whole box is. Which arrays hold that corner only depends on the signs of the normal.
+        const GLfloat* cornerX[6];
+        const GLfloat* cornerY[6];
+        const GLfloat* cornerZ[6];
+        for (int p = 0; p < 6; ++p)
+        {
+            cornerX[p] = planes[p].x >= 0.0f ? this->maxX.data() : this->minX.data();
+            cornerY[p] = planes[p].y >= 0.0f ? this->maxY.data() : this->minY.data();
+            cornerZ[p] = planes[p].z >= 0.0f ? this->maxZ.data() : this->minZ.data();
+        }
+
+        for (size_t i = 0; i < this->minX.size(); i += LANES)
+        {
+#if defined(__AVX__)
+            __m256 outside = _mm256_setzero_ps();
+            for (int p = 0; p < 6; ++p)
+            {
+                __m256 distance = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[p].x), _mm256_loadu_ps(cornerX[p] + i)),
+                                  _mm256_mul_ps(_mm256_set1_ps(planes[p].y), _mm256_loadu_ps(cornerY[p] + i))),
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[p].z), _mm256_loadu_ps(cornerZ[p] + i)),
+                                  _mm256_set1_ps(planes[p].w)));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+            }
+            int mask = _mm256_movemask_ps(outside);
+#elif defined(BOUNDS_SSE)
+            __m128 outside = _mm_setzero_ps();
+            for (int p = 0; p < 6; ++p)
+            {
+                __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), _mm_loadu_ps(cornerX[p] + i)),
+                               _mm_mul_ps(_mm_set1_ps(planes[p].y), _mm_loadu_ps(cornerY[p] + i))),
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].z), _mm_loadu_ps(cornerZ[p] + i)),
+                               _mm_set1_ps(planes[p].w)));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+            }
+            int mask = _mm_movemask_ps(outside);
+#else
+            int mask = 0;
+            for (int p = 0; p < 6; ++p)
+            {
+                if (planes[p].x * cornerX[p][i] + planes[p].y * cornerY[p][i] + planes[p].z * cornerZ[p][i] + planes[p].w < 0.0f)
+                    mask = 1;
+            }
+#endif
+            for (size_t lane = 0; lane < LANES; ++lane)
+                visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+        }
+
+        visible.resize(this->count);
+        return (size_t)std::count(visible.begin(), visible.end(), (GLubyte)1);
+    }
+
+private:
+    size_t count = 0;
+    std::vector<GLfloat> minX, minY, minZ, maxX, maxY, maxZ;
+};
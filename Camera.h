@@ -24,9 +24,13 @@ const GLfloat PITCH      =  0.0f;
 const GLfloat SPEED      =  3.0f;
 const GLfloat SENSITIVTY =  0.25f;
 const GLfloat ZOOM       =  45.0f;
+const GLfloat NEAR_PLANE =  0.1f;
+const GLfloat FAR_PLANE  =  100.0f;
 
 
-// An abstract camera class that processes input and calculates the corresponding Eular Angles, Vectors and Matrices for use in OpenGL
+// An abstract camera class that processes input and calculates the corresponding Eular Angles, Vectors and Matrices for use in OpenGL.
+// The view, projection and view-projection matrices and the frustum planes are cached and only recomputed after the camera
+// changed. Call MarkDirty() after writing the attributes or options directly instead of through the methods below.
 class Camera
 {
 public:
@@ -43,9 +47,12 @@ public:
     GLfloat MovementSpeed;
     GLfloat MouseSensitivity;
     GLfloat Zoom;
+    GLfloat Aspect;
+    GLfloat Near;
+    GLfloat Far;
 
     // Constructor with vectors
-    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), GLfloat yaw = YAW, GLfloat pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVTY), Zoom(ZOOM)
+    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), GLfloat yaw = YAW, GLfloat pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVTY), Zoom(ZOOM), Aspect(1.0f), Near(NEAR_PLANE), Far(FAR_PLANE)
     {
         this->Position = position;
         this->WorldUp = up;
@@ -54,7 +61,7 @@ public:
         this->updateCameraVectors();
     }
     // Constructor with scalar values
-    Camera(GLfloat posX, GLfloat posY, GLfloat posZ, GLfloat upX, GLfloat upY, GLfloat upZ, GLfloat yaw, GLfloat pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVTY), Zoom(ZOOM)
+    Camera(GLfloat posX, GLfloat posY, GLfloat posZ, GLfloat upX, GLfloat upY, GLfloat upZ, GLfloat yaw, GLfloat pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVTY), Zoom(ZOOM), Aspect(1.0f), Near(NEAR_PLANE), Far(FAR_PLANE)
     {
         this->Position = glm::vec3(posX, posY, posZ);
         this->WorldUp = glm::vec3(upX, upY, upZ);
@@ -64,15 +71,80 @@ public:
     }
 
     // Returns the view matrix calculated using Eular Angles and the LookAt Matrix
-    glm::mat4 GetViewMatrix()
+    const glm::mat4& GetViewMatrix()
     {
-        return glm::lookAt(this->Position, this->Position + this->Front, this->Up);
+        this->update();
+        return this->view;
+    }
+
+    // Returns the perspective projection with Zoom as the vertical field of view in degrees
+    const glm::mat4& GetProjectionMatrix()
+    {
+        this->update();
+        return this->projection;
+    }
+
+    const glm::mat4& GetViewProjectionMatrix()
+    {
+        this->update();
+        return this->viewProjection;
+    }
+
+    // Returns the 6 world space frustum planes (left, right, bottom, top, near, far) as (normal, distance) with normalized,
+    // inward facing normals: a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+    const glm::vec4* GetFrustumPlanes()
+    {
+        this->update();
+        return this->frustum;
+    }
+
+    // Incremented every time the cached matrices are recomputed, so users of them can tell whether they changed
+    GLuint Revision()
+    {
+        this->update();
+        return this->revision;
+    }
+
+    // Sets the projection parameters, the field of view stays Zoom
+    void SetPerspective(GLfloat aspect, GLfloat nearPlane, GLfloat farPlane)
+    {
+        if (aspect == this->Aspect && nearPlane == this->Near && farPlane == this->Far)
+            return;
+        this->Aspect = aspect;
+        this->Near = nearPlane;
+        this->Far = farPlane;
+        this->projectionDirty = true;
+    }
+
+    // Moves and turns the camera, the vectors are only recalculated when the angles changed
+    void SetPose(const glm::vec3& position, GLfloat yaw, GLfloat pitch)
+    {
+        if (position != this->Position)
+        {
+            this->Position = position;
+            this->viewDirty = true;
+        }
+        if (yaw != this->Yaw || pitch != this->Pitch)
+        {
+            this->Yaw = yaw;
+            this->Pitch = pitch;
+            this->updateCameraVectors();
+        }
+    }
+
+    // Invalidates the cached matrices after the attributes or options were written directly
+    void MarkDirty()
+    {
+        this->updateCameraVectors();
+        this->projectionDirty = true;
     }
 
     // Processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, GLfloat deltaTime)
     {
         GLfloat velocity = this->MovementSpeed * deltaTime;
+        if (velocity != 0.0f)
+            this->viewDirty = true;
         if (direction == FORWARD)
             this->Position += this->Front * velocity;
         if (direction == BACKWARD)
@@ -108,15 +180,57 @@ public:
     // Processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
     void ProcessMouseScroll(GLfloat yoffset)
     {
+        GLfloat zoom = this->Zoom;
         if (this->Zoom >= 1.0f && this->Zoom <= 45.0f)
             this->Zoom -= yoffset;
         if (this->Zoom <= 1.0f)
             this->Zoom = 1.0f;
         if (this->Zoom >= 45.0f)
             this->Zoom = 45.0f;
+        if (this->Zoom != zoom)
+            this->projectionDirty = true;
     }
 
 private:
+    // Cached matrices and the flags telling which of them are out of date
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 frustum[6];
+    GLuint revision = 0;
+    bool viewDirty = true;
+    bool projectionDirty = true;
+
+    // Recomputes whatever the last changes invalidated
+    void update()
+    {
+        if (!this->viewDirty && !this->projectionDirty)
+            return;
+        if (this->viewDirty)
+            this->view = glm::lookAt(this->Position, this->Position + this->Front, this->Up);
+        if (this->projectionDirty)
+            this->projection = glm::perspective(glm::radians(this->Zoom), this->Aspect, this->Near, this->Far);
+        this->viewProjection = this->projection * this->view;
+
+        // Gribb/Hartmann: every plane is the last row of the view-projection plus or minus one of the others
+        const glm::mat4& m = this->viewProjection;
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; ++i)
+            rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+        this->frustum[0] = rows[3] + rows[0]; // Left
+        this->frustum[1] = rows[3] - rows[0]; // Right
+        this->frustum[2] = rows[3] + rows[1]; // Bottom
+        this->frustum[3] = rows[3] - rows[1]; // Top
+        this->frustum[4] = rows[3] + rows[2]; // Near
+        this->frustum[5] = rows[3] - rows[2]; // Far
+        for (glm::vec4& plane : this->frustum)
+            plane /= glm::length(glm::vec3(plane));
+
+        this->viewDirty = false;
+        this->projectionDirty = false;
+        this->revision++;
+    }
+
     // Calculates the front vector from the Camera's (updated) Eular Angles
     void updateCameraVectors()
     {
@@ -129,5 +243,6 @@ private:
         // Also re-calculate the Right and Up vector
         this->Right = glm::normalize(glm::cross(this->Front, this->WorldUp));  // Normalize the vectors, because their length gets closer to 0 the more you look up or down which results in slower movement.
         this->Up    = glm::normalize(glm::cross(this->Right, this->Front));
+        this->viewDirty = true;
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+// Std. Includes
+#include <vector>
+
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+
+// Camera position and orientation at one point of a path
+struct CameraPose
+{
+    glm::vec3 Position;
+    GLfloat Yaw;
+    GLfloat Pitch;
+};
+
+// Deterministic camera flythrough through a list of keyframes, used by the automated (headless/benchmark) runs
+class CameraPath
+{
+public:
+    std::vector<CameraPose> Keyframes;
+
+    // The default tour: start at the initial camera, move in on the TV, look across the cabinet and come back
+    CameraPath()
+    {
+        this->Keyframes = {
+            { glm::vec3( 0.0f,  0.0f, 5.0f),  -90.0f,  0.0f },
+            { glm::vec3( 0.0f, -0.1f, 3.0f),  -90.0f,  0.0f },
+            { glm::vec3(-0.6f, -0.3f, 2.5f),  -75.0f, -5.0f },
+            { glm::vec3( 0.6f, -0.3f, 2.5f), -105.0f, -5.0f },
+            { glm::vec3( 0.0f, -0.5f, 1.5f),  -90.0f, -10.0f },
+            { glm::vec3( 0.0f,  0.0f, 5.0f),  -90.0f,  0.0f }
+        };
+    }
+
+    // Returns the pose at t in [0, 1], linearly interpolated between evenly spaced keyframes
+    CameraPose Sample(GLfloat t) const
+    {
+        if (this->Keyframes.size() < 2)
+            return this->Keyframes.empty() ? CameraPose{ glm::vec3(0.0f, 0.0f, 5.0f), -90.0f, 0.0f } : this->Keyframes[0];
+
+        t = glm::clamp(t, 0.0f, 1.0f) * (GLfloat)(this->Keyframes.size() - 1);
+        size_t index = (size_t)t;
+        if (index >= this->Keyframes.size() - 1)
+            return this->Keyframes.back();
+        GLfloat f = t - (GLfloat)index;
+
+        const CameraPose& a = this->Keyframes[index];
+        const CameraPose& b = this->Keyframes[index + 1];
+        CameraPose pose;
+        pose.Position = a.Position + (b.Position - a.Position) * f;
+        pose.Yaw = a.Yaw + (b.Yaw - a.Yaw) * f;
+        pose.Pitch = a.Pitch + (b.Pitch - a.Pitch) * f;
+        return pose;
+    }
+};
@@ -0,0 +1,144 @@
+#pragma once
+
+// Std. Includes
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+
+// Watches files for changes on a background thread with inotify. The directories holding the files are
+// watched rather than the files themselves, so editors that save by writing a new file and renaming it
+// over the old one are noticed too. Poll() hands the changed paths to the caller's thread.
+// On platforms without inotify Watch() does nothing and Poll() never reports a change.
+class FileWatcher
+{
+public:
+    // Runs on the watcher thread whenever a watched file changed, e.g. to wake a thread waiting for events
+    std::function<void()> OnChange;
+
+    ~FileWatcher()
+    {
+        this->Stop();
+#ifdef __linux__
+        if (this->fd >= 0)
+            close(this->fd);
+#endif
+    }
+
+    // Starts watching path, the watcher thread is started by the first call
+    bool Watch(const std::string& path)
+    {
+#ifdef __linux__
+        if (this->fd < 0)
+        {
+            this->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (this->fd < 0)
+            {
+                std::cout << "ERROR::WATCHER::INOTIFY_INIT_FAILED" << std::endl;
+                return false;
+            }
+        }
+
+        std::filesystem::path file(path);
+        std::string directory = file.parent_path().empty() ? "." : file.parent_path().string();
+        int wd = inotify_add_watch(this->fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (wd < 0)
+        {
+            std::cout << "ERROR::WATCHER::WATCH_FAILED: " << directory << std::endl;
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->files[std::make_pair(wd, file.filename().string())] = path;
+        }
+        if (!this->thread.joinable())
+            this->thread = std::thread(&FileWatcher::run, this);
+        return true;
+#else
+        (void)path;
+        return false;
+#endif
+    }
+
+    // Stops and joins the watcher thread, OnChange is not called any more afterwards
+    void Stop()
+    {
+        this->stopping = true;
+        if (this->thread.joinable())
+            this->thread.join();
+    }
+
+    // Moves the paths changed since the last call into changed, returns false when there are none
+    bool Poll(std::vector<std::string>& changed)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        changed.swap(this->pending);
+        this->pending.clear();
+        return !changed.empty();
+    }
+
+private:
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+    std::mutex mutex;
+    // (watch descriptor, file name) -> path as passed to Watch()
+    std::map<std::pair<int, std::string>, std::string> files;
+    std::vector<std::string> pending;
+    int fd = -1;
+
+#ifdef __linux__
+    // Watcher thread: waits for inotify events, waking up regularly to notice the destructor
+    void run()
+    {
+        alignas(inotify_event) char buffer[4096];
+        while (!this->stopping)
+        {
+            pollfd descriptor = { this->fd, POLLIN, 0 };
+            if (poll(&descriptor, 1, 100) <= 0)
+                continue;
+
+            bool changed = false;
+            ssize_t length;
+            while ((length = read(this->fd, buffer, sizeof(buffer))) > 0)
+            {
+                for (char* p = buffer; p < buffer + length;)
+                {
+                    const inotify_event* event = (const inotify_event*)p;
+                    p += sizeof(inotify_event) + event->len;
+                    if (event->len == 0)
+                        continue;
+
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    std::map<std::pair<int, std::string>, std::string>::const_iterator it =
+                        this->files.find(std::make_pair(event->wd, std::string(event->name)));
+                    // One save can raise several events, report every file once
+                    if (it != this->files.end() &&
+                        std::find(this->pending.begin(), this->pending.end(), it->second) == this->pending.end())
+                    {
+                        this->pending.push_back(it->second);
+                        changed = true;
+                    }
+                }
+            }
+            if (changed && this->OnChange)
+                this->OnChange();
+        }
+    }
+#else
+    void run() {}
+#endif
+};
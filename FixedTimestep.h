@@ -0,0 +1,46 @@
+#pragma once
+
+// Std. Includes
+#include <algorithm>
+
+// GL Includes
+#include <GL/glew.h>
+
+
+// Clock of a fixed-timestep simulation. Advance() banks the real time of a frame and returns how many
+// steps of Step seconds to simulate, the remainder carries over to the next frame. Alpha() is how far
+// the frame lies between the last two simulated states, so rendering can interpolate between them.
+class FixedTimestep
+{
+public:
+    // Longer frames (window drags, breakpoints) are clamped so the simulation never tries to catch up
+    static constexpr double MAX_FRAME_TIME = 0.25;
+
+    const double Step;
+
+    explicit FixedTimestep(double step = 1.0 / 120.0) : Step(step)
+    {
+    }
+
+    // Adds frameTime seconds and returns the number of whole steps now due
+    int Advance(double frameTime)
+    {
+        this->accumulator += std::min(std::max(frameTime, 0.0), MAX_FRAME_TIME);
+        int steps = 0;
+        while (this->accumulator >= this->Step)
+        {
+            this->accumulator -= this->Step;
+            steps++;
+        }
+        return steps;
+    }
+
+    // Fraction of a step left over after the last Advance(), in [0, 1)
+    GLfloat Alpha() const
+    {
+        return (GLfloat)(this->accumulator / this->Step);
+    }
+
+private:
+    double accumulator = 0.0;
+};
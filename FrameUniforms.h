@@ -0,0 +1,75 @@
+#pragma once
+
+// Std. Includes
+#include <cstddef>
+
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+
+// Per-frame data as laid out in the std140 FrameData block of the shaders
+struct FrameData
+{
+    glm::mat4 View;
+    glm::mat4 Projection;
+    glm::mat4 ViewProjection;
+    glm::vec4 CameraPosition; // w unused
+    GLfloat Time;
+    GLuint HighlightObject; // object ID tinted by the OBJECT_ID shader variants, 0 for none
+    GLfloat Padding[2];
+};
+
+// Uniform buffer holding the camera data every program reads. UpdateCamera() writes it only when the camera moved,
+// UpdateTime() every frame and UpdateHighlight() when the hovered object changes.
+class FrameUniforms
+{
+public:
+    // Binding point of the FrameData block, see Shader::BindUniformBlock
+    static const GLuint BINDING = 0;
+
+    GLuint UBO = 0;
+
+    void Create()
+    {
+        glGenBuffers(1, &this->UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, this->UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, this->UBO);
+    }
+
+    // Uploads the camera part of the block, leaving the time as it is
+    void UpdateCamera(const glm::mat4& view, const glm::mat4& projection, const glm::mat4& viewProjection, const glm::vec3& cameraPosition)
+    {
+        FrameData data;
+        data.View = view;
+        data.Projection = projection;
+        data.ViewProjection = viewProjection;
+        data.CameraPosition = glm::vec4(cameraPosition, 1.0f);
+
+        glBindBuffer(GL_UNIFORM_BUFFER, this->UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, offsetof(FrameData, Time), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void UpdateTime(GLfloat time)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, this->UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, offsetof(FrameData, Time), sizeof(GLfloat), &time);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void UpdateHighlight(GLuint objectId)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, this->UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, offsetof(FrameData, HighlightObject), sizeof(GLuint), &objectId);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void Release()
+    {
+        glDeleteBuffers(1, &this->UBO);
+        this->UBO = 0;
+    }
+};
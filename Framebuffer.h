@@ -0,0 +1,135 @@
+#pragma once
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+// GL Includes
+#include <GL/glew.h>
+
+
+// Offscreen render target: an RGBA8 colour and a 24-bit depth renderbuffer behind one framebuffer object.
+// The depth attachment can be a 32-bit float texture instead, for passes that sample the depth afterwards, and
+// an R32UI object ID renderbuffer can be added as colour attachment 1 for the OBJECT_ID shader variants.
+class Framebuffer
+{
+public:
+    GLuint FBO = 0, ColorBuffer = 0, DepthBuffer = 0, ObjectIdBuffer = 0;
+    GLsizei Width = 0, Height = 0;
+    // DepthBuffer is a GL_TEXTURE_2D rather than a renderbuffer
+    bool DepthTexture = false;
+
+    // Creates the attachments, returns false if the framebuffer is incomplete
+    bool Create(GLsizei width, GLsizei height, bool depthTexture = false, bool objectIds = false)
+    {
+        this->Width = width;
+        this->Height = height;
+        this->DepthTexture = depthTexture;
+
+        glGenFramebuffers(1, &this->FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+
+        glGenRenderbuffers(1, &this->ColorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, this->ColorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->ColorBuffer);
+
+        if (objectIds)
+        {
+            glGenRenderbuffers(1, &this->ObjectIdBuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, this->ObjectIdBuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, this->ObjectIdBuffer);
+            const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+            glDrawBuffers(2, drawBuffers);
+        }
+
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        if (depthTexture)
+        {
+            glGenTextures(1, &this->DepthBuffer);
+            glBindTexture(GL_TEXTURE_2D, this->DepthBuffer);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, this->DepthBuffer, 0);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        else
+        {
+            glGenRenderbuffers(1, &this->DepthBuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, this->DepthBuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->DepthBuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        }
+
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!complete)
+            std::cout << "ERROR::FRAMEBUFFER::INCOMPLETE" << std::endl;
+        return complete;
+    }
+
+    void Bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+        glViewport(0, 0, this->Width, this->Height);
+    }
+
+    // Sets every object ID to 0 (the background), glClear leaves integer attachments undefined
+    void ClearObjectIds() const
+    {
+        const GLuint zero[4] = { 0, 0, 0, 0 };
+        glClearBufferuiv(GL_COLOR, 1, zero);
+    }
+
+    // Copies the colour attachment to the window's back buffer
+    void Present() const
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, this->FBO);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, this->Width, this->Height, 0, 0, this->Width, this->Height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+    }
+
+    // Reads the colour attachment back and writes it as a binary PPM (P6), top row first
+    bool SavePPM(const std::string& path) const
+    {
+        std::vector<unsigned char> pixels((size_t)this->Width * this->Height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, this->FBO);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, this->Width, this->Height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cout << "ERROR::FRAMEBUFFER::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        file << "P6\n" << this->Width << " " << this->Height << "\n255\n";
+        // GL rows start at the bottom of the image
+        size_t rowSize = (size_t)this->Width * 3;
+        for (GLsizei y = this->Height - 1; y >= 0; --y)
+            file.write((const char*)&pixels[y * rowSize], rowSize);
+        return file.good();
+    }
+
+    void Release()
+    {
+        glDeleteRenderbuffers(1, &this->ColorBuffer);
+        glDeleteRenderbuffers(1, &this->ObjectIdBuffer);
+        if (this->DepthTexture)
+            glDeleteTextures(1, &this->DepthBuffer);
+        else
+            glDeleteRenderbuffers(1, &this->DepthBuffer);
+        glDeleteFramebuffers(1, &this->FBO);
+        this->FBO = this->ColorBuffer = this->DepthBuffer = this->ObjectIdBuffer = 0;
+    }
+};
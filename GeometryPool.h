@@ -0,0 +1,135 @@
+#pragma once
+
+// Std. Includes
+#include <vector>
+#include <cstddef>
+#include <iostream>
+
+// GL Includes
+#include <GL/glew.h>
+
+
+// Where one object's geometry lives inside the pool
+struct DrawRange
+{
+    GLenum Mode;        // GL_TRIANGLES, GL_LINES, ...
+    GLsizei Count;      // number of indices to draw
+    GLuint FirstIndex;  // offset of the first index in the index buffer
+    GLint BaseVertex;   // offset added to every index of the range
+};
+
+// Packs the static geometry of every object into one vertex buffer and one index buffer behind a single VAO.
+// Every vertex is position (location 0, 3 floats) followed by a texture coordinate (location 1, 2 floats),
+// so solid colour and textured objects share the same layout and can be drawn without rebinding anything.
+class GeometryPool
+{
+public:
+    static const GLint FLOATS_PER_VERTEX = 5;
+    // Indices are 16 bit, so one range can address at most this many vertices
+    static const size_t MAX_RANGE_VERTICES = 65536;
+
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+
+    // Reserves room for the vertices and indices still to be added, so the pool grows once
+    void Reserve(size_t vertexCount, size_t indexCount)
+    {
+        this->vertices.reserve(this->vertices.size() + vertexCount * FLOATS_PER_VERTEX);
+        this->indices.reserve(this->indices.size() + indexCount);
+    }
+
+    // Appends vertexCount vertices with floatsPerVertex components (3 = position only, 5 = position + tex coords).
+    // When indices is null the vertices are drawn in order. Returns the range to pass to Draw(), an empty one when
+    // there are more than MAX_RANGE_VERTICES vertices.
+    DrawRange Add(GLenum mode, const GLfloat* vertices, size_t vertexCount, GLint floatsPerVertex,
+                  const GLushort* indices = nullptr, size_t indexCount = 0)
+    {
+        DrawRange range;
+        range.Mode = mode;
+        range.Count = 0;
+        range.FirstIndex = (GLuint)this->indices.size();
+        range.BaseVertex = (GLint)(this->vertices.size() / FLOATS_PER_VERTEX);
+        if (vertexCount > MAX_RANGE_VERTICES)
+        {
+            std::cout << "ERROR::GEOMETRY::TOO_MANY_VERTICES: " << vertexCount << std::endl;
+            return range;
+        }
+
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            const GLfloat* src = &vertices[v * floatsPerVertex];
+            this->vertices.insert(this->vertices.end(), src, src + 3);
+            if (floatsPerVertex >= 5)
+                this->vertices.insert(this->vertices.end(), src + 3, src + 5);
+            else
+                this->vertices.insert(this->vertices.end(), 2, 0.0f);
+        }
+
+        if (indices)
+        {
+            this->indices.insert(this->indices.end(), indices, indices + indexCount);
+        }
+        else
+        {
+            for (size_t v = 0; v < vertexCount; ++v)
+                this->indices.push_back((GLushort)v);
+        }
+        range.Count = (GLsizei)(this->indices.size() - range.FirstIndex);
+        return range;
+    }
+
+    DrawRange Add(GLenum mode, const std::vector<GLfloat>& vertices, GLint floatsPerVertex, const std::vector<GLushort>* indices = nullptr)
+    {
+        return this->Add(mode, vertices.data(), vertices.size() / floatsPerVertex, floatsPerVertex,
+                         indices ? indices->data() : nullptr, indices ? indices->size() : 0);
+    }
+
+    // Creates the GL buffers from everything added so far and drops the CPU copy
+    void Upload()
+    {
+        glGenVertexArrays(1, &this->VAO);
+        glGenBuffers(1, &this->VBO);
+        glGenBuffers(1, &this->EBO);
+
+        glBindVertexArray(this->VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+        glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(GLfloat), this->vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLushort), this->indices.data(), GL_STATIC_DRAW);
+
+        // Position attribute (3 floats)
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(GLfloat), (GLvoid*)0);
+        glEnableVertexAttribArray(0);
+        // Texture coordinate attribute (2 floats)
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+
+        std::vector<GLfloat>().swap(this->vertices);
+        std::vector<GLushort>().swap(this->indices);
+    }
+
+    // Binds the pool's VAO, after which any range can be drawn
+    void Bind() const
+    {
+        glBindVertexArray(this->VAO);
+    }
+
+    // Draws one range, the pool must be bound
+    void Draw(const DrawRange& range) const
+    {
+        glDrawElementsBaseVertex(range.Mode, range.Count, GL_UNSIGNED_SHORT,
+                                 (GLvoid*)(range.FirstIndex * sizeof(GLushort)), range.BaseVertex);
+    }
+
+    void Release()
+    {
+        glDeleteVertexArrays(1, &this->VAO);
+        glDeleteBuffers(1, &this->VBO);
+        glDeleteBuffers(1, &this->EBO);
+        this->VAO = this->VBO = this->EBO = 0;
+    }
+
+private:
+    std::vector<GLfloat> vertices;
+    std::vector<GLushort> indices;
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// GL Includes
+#include <GL/glew.h>
+
+
+// Measures GPU time per render pass with GL_TIMESTAMP queries.
+// Every frame owns its own set of queries and results are collected FRAME_LATENCY frames later,
+// only if the GPU has already written them, so reading them never waits on the pipeline.
+// Register the passes once with AddScope(), then per frame: BeginFrame(), GpuScope blocks, EndFrame().
+class GpuProfiler
+{
+public:
+    static const int FRAME_LATENCY = 3;
+    static const int MAX_SCOPES = 8;
+
+    bool Enabled = false;
+
+    GpuProfiler()
+    {
+        for (FrameQueries& f : this->frames)
+        {
+            glGenQueries(MAX_SCOPES, f.Begin);
+            glGenQueries(MAX_SCOPES, f.End);
+        }
+    }
+
+    // Deletes the queries, call while the GL context is still current
+    void Release()
+    {
+        for (FrameQueries& f : this->frames)
+        {
+            glDeleteQueries(MAX_SCOPES, f.Begin);
+            glDeleteQueries(MAX_SCOPES, f.End);
+        }
+    }
+
+    // Registers a pass and returns its id, or -1 when MAX_SCOPES passes already exist
+    int AddScope(const std::string& name)
+    {
+        if ((int)this->names.size() >= MAX_SCOPES)
+            return -1;
+        this->names.push_back(name);
+        this->averages.push_back(0.0);
+        return (int)this->names.size() - 1;
+    }
+
+    // Writes one line per collected frame with every pass time in milliseconds to path
+    bool OpenCSV(const std::string& path)
+    {
+        this->csv.open(path);
+        if (!this->csv.is_open())
+        {
+            std::cout << "ERROR::PROFILER::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        this->csv << "frame";
+        for (const std::string& name : this->names)
+            this->csv << "," << name << "_ms";
+        this->csv << "\n";
+        return true;
+    }
+
+    void BeginFrame()
+    {
+        if (!this->Enabled)
+            return;
+        FrameQueries& f = this->frames[this->frameCount % FRAME_LATENCY];
+        if (f.Pending)
+            this->collect(f);
+        for (bool& used : f.Used)
+            used = false;
+    }
+
+    void Begin(int scope)
+    {
+        if (!this->Enabled || scope < 0)
+            return;
+        FrameQueries& f = this->frames[this->frameCount % FRAME_LATENCY];
+        glQueryCounter(f.Begin[scope], GL_TIMESTAMP);
+        f.Used[scope] = true;
+    }
+
+    void End(int scope)
+    {
+        if (!this->Enabled || scope < 0)
+            return;
+        glQueryCounter(this->frames[this->frameCount % FRAME_LATENCY].End[scope], GL_TIMESTAMP);
+    }
+
+    void EndFrame()
+    {
+        if (!this->Enabled)
+            return;
+        FrameQueries& f = this->frames[this->frameCount % FRAME_LATENCY];
+        f.Pending = true;
+        f.Frame = this->frameCount++;
+    }
+
+    // Smoothed GPU time of a pass in milliseconds
+    double Average(int scope) const
+    {
+        return scope >= 0 && scope < (int)this->averages.size() ? this->averages[scope] : 0.0;
+    }
+
+    // "name 0.123 ms | ..." for every pass, used by the stats overlay
+    std::string Summary() const
+    {
+        std::string text;
+        for (size_t i = 0; i < this->names.size(); ++i)
+        {
+            char buffer[64];
+            snprintf(buffer, sizeof(buffer), "%s%s %.3f ms", i ? " | " : "", this->names[i].c_str(), this->averages[i]);
+            text += buffer;
+        }
+        return text;
+    }
+
+private:
+    struct FrameQueries
+    {
+        GLuint Begin[MAX_SCOPES];
+        GLuint End[MAX_SCOPES];
+        bool Used[MAX_SCOPES] = {};
+        bool Pending = false;
+        long Frame = 0;
+    };
+
+    FrameQueries frames[FRAME_LATENCY];
+    long frameCount = 0;
+    std::vector<std::string> names;
+    std::vector<double> averages;
+    std::ofstream csv;
+
+    // Reads the timestamps of a finished frame, dropping the frame if the GPU hasn't caught up yet
+    void collect(FrameQueries& f)
+    {
+        f.Pending = false;
+        for (size_t i = 0; i < this->names.size(); ++i)
+        {
+            if (!f.Used[i])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(f.End[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                return;
+        }
+
+        if (this->csv.is_open())
+            this->csv << f.Frame;
+        for (size_t i = 0; i < this->names.size(); ++i)
+        {
+            double ms = 0.0;
+            if (f.Used[i])
+            {
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(f.Begin[i], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(f.End[i], GL_QUERY_RESULT, &end);
+                ms = (end - begin) / 1.0e6;
+                this->averages[i] += (ms - this->averages[i]) * 0.1;
+            }
+            if (this->csv.is_open())
+                this->csv << "," << ms;
+        }
+        if (this->csv.is_open())
+            this->csv << "\n";
+    }
+};
+
+// Times the enclosing block as one pass of the profiler
+class GpuScope
+{
+public:
+    GpuScope(GpuProfiler& profiler, int scope) : profiler(profiler), scope(scope)
+    {
+        this->profiler.Begin(this->scope);
+    }
+    ~GpuScope()
+    {
+        this->profiler.End(this->scope);
+    }
+
+private:
+    GpuProfiler& profiler;
+    int scope;
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+// Std. Includes
+#include <vector>
+#include <algorithm>
+
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "Bounds.h"
+#include "BatchRenderer.h"
+
+
+// GPU occlusion culling against a hierarchical depth (Hi-Z) pyramid of the previous frame.
+// After a frame is drawn, BuildPyramid() copies its depth texture into level 0 of an R32F mip chain and reduces
+// every level to the farthest depth of the 2x2 texels below it (hiz_pyramid.comp). Before the next frame, Cull()
+// runs hiz_cull.comp over a BatchRenderer's indirect commands: boxes whose nearest depth lies behind the pyramid
+// get an instance count of 0 in a second command buffer, which is then drawn instead. Objects that just came out
+// from behind an occluder show up one frame late, so draw one more frame after the camera stops.
+// Needs OpenGL 4.3 (compute shaders and storage buffers).
+class HiZCuller
+{
+public:
+    // Texture unit the depth texture and the pyramid are sampled from, unit 0 holds the texture array
+    static const GLuint TEXTURE_UNIT = 1;
+
+    static bool Supported()
+    {
+        return GLEW_VERSION_4_3;
+    }
+
+    // objectBounds are the boxes of the batch objects in the order they were added (the commands' base instance)
+    HiZCuller(GLsizei width, GLsizei height, const std::vector<AABB>& objectBounds, GLsizei commandCount)
+        : copyShader(Shader::Compute("hiz_pyramid.comp", "#define COPY_DEPTH\n")),
+          downsampleShader(Shader::Compute("hiz_pyramid.comp")),
+          cullShader(Shader::Compute("hiz_cull.comp")),
+          width(width), height(height), commandCount(commandCount)
+    {
+        this->levels = 1;
+        while ((std::max(width, height) >> this->levels) > 0)
+            this->levels++;
+        glGenTextures(1, &this->pyramid);
+        glBindTexture(GL_TEXTURE_2D, this->pyramid);
+        glTexStorage2D(GL_TEXTURE_2D, this->levels, GL_R32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        std::vector<glm::vec4> corners;
+        corners.reserve(objectBounds.size() * 2);
+        for (const AABB& box : objectBounds)
+        {
+            corners.push_back(glm::vec4(box.Min, 1.0f));
+            corners.push_back(glm::vec4(box.Max, 1.0f));
+        }
+        glGenBuffers(1, &this->boundsBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->boundsBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, corners.size() * sizeof(glm::vec4), corners.data(), GL_STATIC_DRAW);
+
+        glGenBuffers(1, &this->culledCommands);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->culledCommands);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, commandCount * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_COPY);
+
+        GLuint zero = 0;
+        glGenBuffers(1, &this->statistics);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->statistics);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_READ);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        this->viewProjectionLocation = this->cullShader.Uniform(UniformHash("pyramidViewProjection"));
+        this->commandCountLocation = this->cullShader.Uniform(UniformHash("commandCount"));
+    }
+
+    ~HiZCuller()
+    {
+        glDeleteTextures(1, &this->pyramid);
+        glDeleteBuffers(1, &this->boundsBuffer);
+        glDeleteBuffers(1, &this->culledCommands);
+        glDeleteBuffers(1, &this->statistics);
+        glDeleteProgram(this->copyShader.Program);
+        glDeleteProgram(this->downsampleShader.Program);
+        glDeleteProgram(this->cullShader.Program);
+    }
+
+    // Builds the pyramid from the depth texture of the frame just drawn with viewProjection
+    void BuildPyramid(GLuint depthTexture, const glm::mat4& viewProjection)
+    {
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        this->copyShader.Use();
+        glBindImageTexture(1, this->pyramid, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((this->width + 7) / 8, (this->height + 7) / 8, 1);
+
+        this->downsampleShader.Use();
+        for (GLint level = 1; level < this->levels; ++level)
+        {
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            GLsizei levelWidth = std::max(1, this->width >> level);
+            GLsizei levelHeight = std::max(1, this->height >> level);
+            glBindImageTexture(0, this->pyramid, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+            glBindImageTexture(1, this->pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+        }
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+
+        this->pyramidViewProjection = viewProjection;
+        this->pyramidValid = true;
+    }
+
+    // Writes the commands of sourceCommands with the occluded objects hidden into Commands(). Until the first
+    // pyramid exists they are copied unchanged.
+    void Cull(GLuint sourceCommands)
+    {
+        GLsizeiptr size = this->commandCount * sizeof(DrawElementsIndirectCommand);
+        if (!this->pyramidValid)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, sourceCommands);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, this->culledCommands);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            return;
+        }
+
+        GLuint zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->statistics);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        this->cullShader.Use();
+        this->cullShader.SetMat4(this->viewProjectionLocation, this->pyramidViewProjection);
+        this->cullShader.SetInt(this->commandCountLocation, this->commandCount);
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, this->pyramid);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, sourceCommands);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->culledCommands);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, this->boundsBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, this->statistics);
+        glDispatchCompute((this->commandCount + 63) / 64, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // Command buffer written by Cull(), same layout and order as the source
+    GLuint Commands() const
+    {
+        return this->culledCommands;
+    }
+
+    // Objects hidden by the last Cull(). Reading it waits for the GPU, so only call it for statistics.
+    GLuint OccludedCount() const
+    {
+        GLuint count = 0;
+        if (!this->pyramidValid)
+            return 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->statistics);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return count;
+    }
+
+private:
+    Shader copyShader, downsampleShader, cullShader;
+    GLsizei width, height;
+    GLint levels;
+    GLsizei commandCount;
+    GLuint pyramid = 0;
+    GLuint boundsBuffer = 0, culledCommands = 0, statistics = 0;
+    glm::mat4 pyramidViewProjection;
+    bool pyramidValid = false;
+    GLint viewProjectionLocation, commandCountLocation;
+};
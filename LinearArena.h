@@ -0,0 +1,73 @@
+#pragma once
+
+// Std. Includes
+#include <memory>
+#include <cstddef>
+#include <type_traits>
+
+
+// Bump allocator over one block reserved up front. Allocate() hands out consecutive pieces of the block, each
+// aligned to ALIGNMENT, and nothing is freed on its own: Reset() makes the whole block reusable (per frame, or
+// after a load), and the block goes away with the arena. Only for trivially destructible types, no destructors
+// are run. Size the block with Footprint() so the allocations fit, Allocate() returns nullptr once it is full.
+class LinearArena
+{
+public:
+    static const size_t ALIGNMENT = 16;
+
+    explicit LinearArena(size_t capacity = 0)
+    {
+        this->Reserve(capacity);
+    }
+
+    // Replaces the block with one of capacity bytes, everything allocated before is invalid afterwards
+    void Reserve(size_t capacity)
+    {
+        this->storage.reset(capacity > 0 ? new unsigned char[capacity] : nullptr);
+        this->capacity = capacity;
+        this->used = 0;
+    }
+
+    // Bytes count elements of T take in the block, padding included
+    template <typename T>
+    static constexpr size_t Footprint(size_t count)
+    {
+        return (count * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    // Uninitialized room for count elements of T
+    template <typename T>
+    T* Allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "LinearArena never runs destructors");
+        static_assert(alignof(T) <= ALIGNMENT, "LinearArena only aligns to ALIGNMENT");
+        size_t size = Footprint<T>(count);
+        if (this->used + size > this->capacity)
+            return nullptr;
+        T* memory = reinterpret_cast<T*>(this->storage.get() + this->used);
+        this->used += size;
+        return memory;
+    }
+
+    // Makes the whole block available again, without releasing it
+    void Reset()
+    {
+        this->used = 0;
+    }
+
+    size_t Used() const
+    {
+        return this->used;
+    }
+
+    size_t Capacity() const
+    {
+        return this->capacity;
+    }
+
+private:
+    // new[] aligns to __STDCPP_DEFAULT_NEW_ALIGNMENT__, at least 16 on the desktop ABIs
+    std::unique_ptr<unsigned char[]> storage;
+    size_t capacity = 0;
+    size_t used = 0;
+};
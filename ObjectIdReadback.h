@@ -0,0 +1,96 @@
+#pragma once
+
+// GL Includes
+#include <GL/glew.h>
+
+#include "Framebuffer.h"
+
+
+// Reads single object IDs back from a Framebuffer's ID attachment without stalling the pipeline. Request() copies
+// one texel into a pixel buffer object and fences it, Poll() checks the fences without waiting and returns the ID
+// once the GPU got there, usually one or two frames later. Up to SLOTS reads are in flight, requests beyond that
+// are dropped. Nothing is done unless Request() is called, so an idle window costs nothing.
+class ObjectIdReadback
+{
+public:
+    static const int SLOTS = 3;
+
+    void Create()
+    {
+        glGenBuffers(SLOTS, this->buffers);
+        for (int i = 0; i < SLOTS; ++i)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, this->buffers[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+            this->fences[i] = nullptr;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // Queues a read of the ID at pixel (x, y), origin at the bottom left. Returns false when every slot is busy.
+    bool Request(const Framebuffer& framebuffer, GLint x, GLint y)
+    {
+        if (this->count == SLOTS)
+            return false;
+        int slot = (this->first + this->count) % SLOTS;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer.FBO);
+        glReadBuffer(GL_COLOR_ATTACHMENT1);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, this->buffers[slot]);
+        glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        this->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        this->count++;
+        return true;
+    }
+
+    // Collects the reads that finished, in order, and returns true with the newest ID if there was one
+    bool Poll(GLuint& objectId)
+    {
+        bool found = false;
+        while (this->count > 0)
+        {
+            // A timeout of 0 only checks, the flush makes sure the fence reaches the GPU even if no frame follows
+            GLenum status = glClientWaitSync(this->fences[this->first], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if (status == GL_TIMEOUT_EXPIRED)
+                break;
+            glDeleteSync(this->fences[this->first]);
+            this->fences[this->first] = nullptr;
+            if (status != GL_WAIT_FAILED)
+            {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, this->buffers[this->first]);
+                glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLuint), &objectId);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                found = true;
+            }
+            this->first = (this->first + 1) % SLOTS;
+            this->count--;
+        }
+        return found;
+    }
+
+    // True while reads are in flight, Poll() has something to collect
+    bool Pending() const
+    {
+        return this->count > 0;
+    }
+
+    void Release()
+    {
+        for (int i = 0; i < SLOTS; ++i)
+        {
+            if (this->fences[i])
+                glDeleteSync(this->fences[i]);
+            this->fences[i] = nullptr;
+        }
+        glDeleteBuffers(SLOTS, this->buffers);
+        this->first = this->count = 0;
+    }
+
+private:
+    GLuint buffers[SLOTS] = {};
+    GLsync fences[SLOTS] = {};
+    // Oldest read in flight and how many there are
+    int first = 0;
+    int count = 0;
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+// Std. Includes
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+
+// CPU occlusion culling for contexts without compute shaders: the triangles of the largest objects are
+// rasterized at low resolution into a depth buffer, then a box is hidden when every pixel of its screen
+// rectangle holds an occluder nearer than the box's nearest point. Depths are NDC z mapped to [0, 1].
+// Pixels are sampled at their centres, so a sliver of an object thinner than a pixel can be hidden.
+class OcclusionBuffer
+{
+public:
+    // Occluders rasterized per Render(), the largest boxes first
+    static const size_t MAX_OCCLUDERS = 64;
+
+    OcclusionBuffer(GLint width, GLint height) : width(width), height(height), depth((size_t)width * height, 1.0f)
+    {
+    }
+
+    // Registers the triangles of one object as an occluder (positions are the first 3 floats of each vertex)
+    void AddOccluder(size_t object, const AABB& box, const GLfloat* vertices, size_t vertexCount, GLint floatsPerVertex,
+                     const GLushort* indices, size_t indexCount)
+    {
+        Occluder occluder;
+        occluder.Object = object;
+        occluder.First = this->triangles.size();
+        occluder.Size = glm::length(box.Max - box.Min);
+        size_t count = indices ? indexCount : vertexCount;
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t v = (indices ? indices[i] : i) * floatsPerVertex;
+            this->triangles.push_back(glm::vec3(vertices[v], vertices[v + 1], vertices[v + 2]));
+        }
+        occluder.Count = this->triangles.size() - occluder.First;
+
+        // Keep the list sorted largest first, so the budget goes to the objects most likely to hide others
+        this->occluders.insert(std::upper_bound(this->occluders.begin(), this->occluders.end(), occluder,
+                                                [](const Occluder& a, const Occluder& b) { return a.Size > b.Size; }),
+                               occluder);
+    }
+
+    // Clears the buffer and rasterizes the occluders whose object is visible
+    void Render(const glm::mat4& viewProjection, const std::vector<GLubyte>& visible)
+    {
+        this->viewProjection = viewProjection;
+        std::fill(this->depth.begin(), this->depth.end(), 1.0f);
+        size_t rendered = 0;
+        for (const Occluder& occluder : this->occluders)
+        {
+            if (rendered == MAX_OCCLUDERS)
+                break;
+            if (!visible[occluder.Object])
+                continue;
+            for (size_t t = occluder.First; t + 2 < occluder.First + occluder.Count; t += 3)
+                this->rasterize(this->triangles[t], this->triangles[t + 1], this->triangles[t + 2]);
+            rendered++;
+        }
+    }
+
+    // True when the box is entirely behind what Render() drew
+    bool Occluded(const AABB& box) const
+    {
+        glm::vec2 rectMin(std::numeric_limits<GLfloat>::max());
+        glm::vec2 rectMax(-std::numeric_limits<GLfloat>::max());
+        GLfloat nearest = 1.0f;
+        for (int i = 0; i < 8; ++i)
+        {
+            glm::vec3 corner((i & 1) ? box.Max.x : box.Min.x, (i & 2) ? box.Max.y : box.Min.y, (i & 4) ? box.Max.z : box.Min.z);
+            glm::vec3 screen;
+            // Boxes reaching behind the near plane can't be projected, keep them
+            if (!this->project(corner, screen))
+                return false;
+            rectMin = glm::min(rectMin, glm::vec2(screen));
+            rectMax = glm::max(rectMax, glm::vec2(screen));
+            nearest = std::min(nearest, screen.z);
+        }
+
+        // Every pixel the rectangle touches, not only the ones whose centre it covers
+        GLint x0 = std::max(0, (GLint)std::floor(rectMin.x));
+        GLint y0 = std::max(0, (GLint)std::floor(rectMin.y));
+        GLint x1 = std::min(this->width - 1, (GLint)std::floor(rectMax.x));
+        GLint y1 = std::min(this->height - 1, (GLint)std::floor(rectMax.y));
+        if (x0 > x1 || y0 > y1)
+            return false;
+        // Small bias so an object is never hidden by its own front faces
+        nearest -= DEPTH_BIAS;
+        for (GLint y = y0; y <= y1; ++y)
+        {
+            const GLfloat* row = &this->depth[(size_t)y * this->width];
+            for (GLint x = x0; x <= x1; ++x)
+            {
+                if (row[x] >= nearest)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr GLfloat DEPTH_BIAS = 1e-5f;
+
+    struct Occluder
+    {
+        size_t Object;
+        size_t First;
+        size_t Count;
+        GLfloat Size;
+    };
+
+    GLint width, height;
+    std::vector<GLfloat> depth;
+    std::vector<glm::vec3> triangles;
+    std::vector<Occluder> occluders;
+    glm::mat4 viewProjection;
+
+    // World position to pixel coordinates and [0, 1] depth, false when it lies behind the near plane
+    bool project(const glm::vec3& position, glm::vec3& screen) const
+    {
+        glm::vec4 clip = this->viewProjection * glm::vec4(position, 1.0f);
+        if (clip.w <= 0.0f || clip.z < -clip.w)
+            return false;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        screen = glm::vec3((ndc.x * 0.5f + 0.5f) * this->width, (ndc.y * 0.5f + 0.5f) * this->height, ndc.z * 0.5f + 0.5f);
+        return true;
+    }
+
+    // Half-space rasterizer over the triangle's bounding rectangle, depth interpolated linearly in screen space
+    void rasterize(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+    {
+        glm::vec3 p0, p1, p2;
+        // Triangles crossing the near plane are skipped, leaving them out only hides less
+        if (!this->project(a, p0) || !this->project(b, p1) || !this->project(c, p2))
+            return;
+        GLfloat area = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+        if (std::fabs(area) < 1e-8f)
+            return;
+
+        GLint x0 = std::max(0, (GLint)std::floor(std::min(p0.x, std::min(p1.x, p2.x))));
+        GLint y0 = std::max(0, (GLint)std::floor(std::min(p0.y, std::min(p1.y, p2.y))));
+        GLint x1 = std::min(this->width - 1, (GLint)std::ceil(std::max(p0.x, std::max(p1.x, p2.x))));
+        GLint y1 = std::min(this->height - 1, (GLint)std::ceil(std::max(p0.y, std::max(p1.y, p2.y))));
+        for (GLint y = y0; y <= y1; ++y)
+        {
+            GLfloat* row = &this->depth[(size_t)y * this->width];
+            for (GLint x = x0; x <= x1; ++x)
+            {
+                GLfloat px = x + 0.5f, py = y + 0.5f;
+                // Barycentric weights from the edge functions, both windings are accepted
+                GLfloat w0 = ((p1.x - px) * (p2.y - py) - (p1.y - py) * (p2.x - px)) / area;
+                GLfloat w1 = ((p2.x - px) * (p0.y - py) - (p2.y - py) * (p0.x - px)) / area;
+                GLfloat w2 = 1.0f - w0 - w1;
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                    continue;
+                GLfloat z = w0 * p0.z + w1 * p1.z + w2 * p2.z;
+                if (z < row[x])
+                    row[x] = z;
+            }
+        }
+    }
+};
@@ -0,0 +1,218 @@
+#pragma once
+
+// Std. Includes
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "BVH.h"
+
+
+// Object under a ray and where the ray hits it, Object is -1 when nothing was hit
+struct PickResult
+{
+    GLint Object = -1;
+    glm::vec3 Point;
+    GLfloat Distance = 0.0f;
+};
+
+// Picks objects by casting rays on the CPU. The BVH finds the objects whose box the ray enters, nearest first,
+// then the ray is tested against their triangles with Moller-Trumbore. Each object's triangles are stored as
+// structure of arrays (first corner and two edges), padded to a multiple of BoundsArray::LANES, so one SIMD
+// test covers 8 triangles with AVX and 4 with SSE. Objects without triangles (lines, the wall) are never hit.
+class Picker
+{
+public:
+    static const size_t LANES = BoundsArray::LANES;
+
+    // Stores the triangles of scene object object, given like GeometryPool::Add (positions are the first 3 floats
+    // of each vertex, no indices means every 3 vertices form a triangle)
+    void Add(size_t object, const GLfloat* vertices, size_t vertexCount, GLint floatsPerVertex,
+             const GLushort* indices, size_t indexCount)
+    {
+        if (this->ranges.size() <= object)
+            this->ranges.resize(object + 1, Range{ 0, 0 });
+        Range& range = this->ranges[object];
+        range.First = this->v0x.size();
+
+        size_t count = indices ? indexCount : vertexCount;
+        for (size_t i = 0; i + 2 < count; i += 3)
+        {
+            glm::vec3 corners[3];
+            for (int c = 0; c < 3; ++c)
+            {
+                size_t v = (indices ? indices[i + c] : i + c) * floatsPerVertex;
+                corners[c] = glm::vec3(vertices[v], vertices[v + 1], vertices[v + 2]);
+            }
+            this->push(corners[0], corners[1] - corners[0], corners[2] - corners[0]);
+        }
+        // Padding triangles are degenerate (zero edges), the determinant test rejects them
+        while ((this->v0x.size() - range.First) % LANES != 0)
+            this->push(glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f));
+        range.Count = this->v0x.size() - range.First;
+    }
+
+    // Distance along the ray to the nearest triangle of object closer than maxDistance, negative on a miss
+    GLfloat Intersect(size_t object, const glm::vec3& origin, const glm::vec3& direction, GLfloat maxDistance) const
+    {
+        if (object >= this->ranges.size())
+            return -1.0f;
+        const Range& range = this->ranges[object];
+        GLfloat closest = maxDistance;
+        bool hit = false;
+        for (size_t i = range.First; i < range.First + range.Count; i += LANES)
+        {
+            GLfloat distances[LANES];
+            this->intersectLanes(i, origin, direction, distances);
+            for (size_t lane = 0; lane < LANES; ++lane)
+            {
+                if (distances[lane] < closest)
+                {
+                    closest = distances[lane];
+                    hit = true;
+                }
+            }
+        }
+        return hit ? closest : -1.0f;
+    }
+
+    // Nearest object along the ray, the BVH must have been built over the same object indices
+    PickResult Pick(const BVH& bvh, const glm::vec3& origin, const glm::vec3& direction,
+                    GLfloat maxDistance = std::numeric_limits<GLfloat>::max()) const
+    {
+        PickResult result;
+        result.Object = bvh.Raycast(origin, direction, maxDistance, result.Distance, [&](GLuint object, GLfloat closest) {
+            return this->Intersect(object, origin, direction, closest);
+        });
+        if (result.Object >= 0)
+            result.Point = origin + direction * result.Distance;
+        return result;
+    }
+
+    // World space ray through a cursor position in window coordinates (origin at the top left), from the near
+    // plane towards the far plane of the camera that drew the frame. direction is normalized.
+    static void CursorRay(const glm::mat4& viewProjection, double x, double y, GLsizei width, GLsizei height,
+                          glm::vec3& origin, glm::vec3& direction)
+    {
+        glm::mat4 inverse = glm::inverse(viewProjection);
+        GLfloat ndcX = (GLfloat)(2.0 * x / width - 1.0);
+        GLfloat ndcY = (GLfloat)(1.0 - 2.0 * y / height);
+        glm::vec4 nearPoint = inverse * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+        glm::vec4 farPoint = inverse * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+        origin = glm::vec3(nearPoint) / nearPoint.w;
+        direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+    }
+
+private:
+    // Smallest determinant treated as a ray parallel to the triangle
+    static constexpr GLfloat EPSILON = 1e-7f;
+
+    struct Range
+    {
+        size_t First;
+        size_t Count;
+    };
+
+    std::vector<Range> ranges;
+    std::vector<GLfloat> v0x, v0y, v0z, e1x, e1y, e1z, e2x, e2y, e2z;
+
+    void push(const glm::vec3& v0, const glm::vec3& e1, const glm::vec3& e2)
+    {
+        this->v0x.push_back(v0.x); this->v0y.push_back(v0.y); this->v0z.push_back(v0.z);
+        this->e1x.push_back(e1.x); this->e1y.push_back(e1.y); this->e1z.push_back(e1.z);
+        this->e2x.push_back(e2.x); this->e2y.push_back(e2.y); this->e2z.push_back(e2.z);
+    }
+
+    // Moller-Trumbore against the LANES triangles starting at first, distances[lane] is the hit distance or
+    // the largest float on a miss
+    void intersectLanes(size_t first, const glm::vec3& origin, const glm::vec3& direction, GLfloat* distances) const
+    {
+#if defined(__AVX__)
+        const __m256 dx = _mm256_set1_ps(direction.x), dy = _mm256_set1_ps(direction.y), dz = _mm256_set1_ps(direction.z);
+        const __m256 e1X = _mm256_loadu_ps(&this->e1x[first]), e1Y = _mm256_loadu_ps(&this->e1y[first]), e1Z = _mm256_loadu_ps(&this->e1z[first]);
+        const __m256 e2X = _mm256_loadu_ps(&this->e2x[first]), e2Y = _mm256_loadu_ps(&this->e2y[first]), e2Z = _mm256_loadu_ps(&this->e2z[first]);
+        // p = direction x e2, det = e1 . p
+        __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2Z), _mm256_mul_ps(dz, e2Y));
+        __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2X), _mm256_mul_ps(dx, e2Z));
+        __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2Y), _mm256_mul_ps(dy, e2X));
+        __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1X, px), _mm256_mul_ps(e1Y, py)), _mm256_mul_ps(e1Z, pz));
+        __m256 absDet = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), det);
+        __m256 valid = _mm256_cmp_ps(absDet, _mm256_set1_ps(EPSILON), _CMP_GT_OQ);
+        __m256 inverseDet = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+        // s = origin - v0, u = (s . p) / det
+        __m256 sx = _mm256_sub_ps(_mm256_set1_ps(origin.x), _mm256_loadu_ps(&this->v0x[first]));
+        __m256 sy = _mm256_sub_ps(_mm256_set1_ps(origin.y), _mm256_loadu_ps(&this->v0y[first]));
+        __m256 sz = _mm256_sub_ps(_mm256_set1_ps(origin.z), _mm256_loadu_ps(&this->v0z[first]));
+        __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), inverseDet);
+        // q = s x e1, v = (direction . q) / det, t = (e2 . q) / det
+        __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1Z), _mm256_mul_ps(sz, e1Y));
+        __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1X), _mm256_mul_ps(sx, e1Z));
+        __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1Y), _mm256_mul_ps(sy, e1X));
+        __m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), inverseDet);
+        __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2X, qx), _mm256_mul_ps(e2Y, qy)), _mm256_mul_ps(e2Z, qz)), inverseDet);
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, zero, _CMP_GE_OQ));
+        _mm256_storeu_ps(distances, _mm256_blendv_ps(_mm256_set1_ps(std::numeric_limits<GLfloat>::max()), t, valid));
+#elif defined(BOUNDS_SSE)
+        const __m128 dx = _mm_set1_ps(direction.x), dy = _mm_set1_ps(direction.y), dz = _mm_set1_ps(direction.z);
+        const __m128 e1X = _mm_loadu_ps(&this->e1x[first]), e1Y = _mm_loadu_ps(&this->e1y[first]), e1Z = _mm_loadu_ps(&this->e1z[first]);
+        const __m128 e2X = _mm_loadu_ps(&this->e2x[first]), e2Y = _mm_loadu_ps(&this->e2y[first]), e2Z = _mm_loadu_ps(&this->e2z[first]);
+        // p = direction x e2, det = e1 . p
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2Z), _mm_mul_ps(dz, e2Y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2X), _mm_mul_ps(dx, e2Z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2Y), _mm_mul_ps(dy, e2X));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1X, px), _mm_mul_ps(e1Y, py)), _mm_mul_ps(e1Z, pz));
+        __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+        __m128 valid = _mm_cmpgt_ps(absDet, _mm_set1_ps(EPSILON));
+        __m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+        // s = origin - v0, u = (s . p) / det
+        __m128 sx = _mm_sub_ps(_mm_set1_ps(origin.x), _mm_loadu_ps(&this->v0x[first]));
+        __m128 sy = _mm_sub_ps(_mm_set1_ps(origin.y), _mm_loadu_ps(&this->v0y[first]));
+        __m128 sz = _mm_sub_ps(_mm_set1_ps(origin.z), _mm_loadu_ps(&this->v0z[first]));
+        __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDet);
+        // q = s x e1, v = (direction . q) / det, t = (e2 . q) / det
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1Z), _mm_mul_ps(sz, e1Y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1X), _mm_mul_ps(sx, e1Z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1Y), _mm_mul_ps(sy, e1X));
+        __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDet);
+        __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2X, qx), _mm_mul_ps(e2Y, qy)), _mm_mul_ps(e2Z, qz)), inverseDet);
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+        valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), one));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(t, zero));
+        // No blend in SSE2: pick t where valid, the largest float elsewhere
+        __m128 miss = _mm_set1_ps(std::numeric_limits<GLfloat>::max());
+        _mm_storeu_ps(distances, _mm_or_ps(_mm_and_ps(valid, t), _mm_andnot_ps(valid, miss)));
+#else
+        for (size_t lane = 0; lane < LANES; ++lane)
+        {
+            size_t i = first + lane;
+            distances[lane] = std::numeric_limits<GLfloat>::max();
+            glm::vec3 e1(this->e1x[i], this->e1y[i], this->e1z[i]);
+            glm::vec3 e2(this->e2x[i], this->e2y[i], this->e2z[i]);
+            glm::vec3 p = glm::cross(direction, e2);
+            GLfloat det = glm::dot(e1, p);
+            if (std::fabs(det) <= EPSILON)
+                continue;
+            GLfloat inverseDet = 1.0f / det;
+            glm::vec3 s = origin - glm::vec3(this->v0x[i], this->v0y[i], this->v0z[i]);
+            GLfloat u = glm::dot(s, p) * inverseDet;
+            glm::vec3 q = glm::cross(s, e1);
+            GLfloat v = glm::dot(direction, q) * inverseDet;
+            GLfloat t = glm::dot(e2, q) * inverseDet;
+            if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f)
+                distances[lane] = t;
+        }
+#endif
+    }
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+
+// Kinds of primitive a scene file line can describe
+enum Primitive_Kind {
+    PRIM_WALL,   // full screen background colour behind everything
+    PRIM_PRISM,  // rectangular prism from 4 pixel-space corners and a z range
+    PRIM_CIRCLE, // flat disc from a pixel-space centre and radius
+    PRIM_LINES   // line segments between pairs of pixel-space points
+};
+
+// Maximum number of pixel-space points a single object carries
+const GLint MAX_OBJECT_POINTS = 4;
+// A circle is 3 vertices per segment, all addressed by the 16-bit indices of the geometry pool
+const GLint MAX_CIRCLE_SEGMENTS = 65536 / 3;
+
+// One drawable object of the scene. Kept free of heap members so the whole scene is one flat array
+struct SceneObject
+{
+    Primitive_Kind Kind;
+    // Pixel-space points: prism corners, line end points or the circle centre in Points[0]
+    glm::vec2 Points[MAX_OBJECT_POINTS];
+    GLint PointCount;
+    // Depth range of the object, flat primitives only use ZFront
+    GLfloat ZFront;
+    GLfloat ZBack;
+    // Circle options
+    GLfloat Radius;
+    GLint Segments;
+    glm::vec4 Color;
+    // Index into Scene::TexturePaths, -1 when the object is a solid colour
+    GLint Texture;
+};
+
+// Loads a scene description file into a flat list of objects.
+//
+// Every non-empty line that doesn't start with '#' describes one object:
+//   wall   <name> <r> <g> <b>
+//   prism  <name> <x0> <y0> <x1> <y1> <x2> <y2> <x3> <y3> <zFront> <zBack> <r> <g> <b> [texture]
+//   circle <name> <cx> <cy> <radius> <segments> <z> <r> <g> <b>
+//   lines  <name> <count> <x0> <y0> ... <z> <r> <g> <b>
+// Coordinates are in window pixels, colours are 0-255.
+class Scene
+{
+public:
+    std::vector<SceneObject> Objects;
+    // Names of the objects, parallel to Objects
+    std::vector<std::string> Names;
+    // Unique texture files referenced by the objects
+    std::vector<std::string> TexturePaths;
+
+    // Parses the file at path, returns false (and leaves the scene empty) on any error
+    bool Load(const GLchar* path)
+    {
+        this->Objects.clear();
+        this->Names.clear();
+        this->TexturePaths.clear();
+
+        std::ifstream file(path);
+        if (!file.is_open())
+        {
+            std::cout << "ERROR::SCENE::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            return false;
+        }
+
+        std::string line;
+        GLint lineNumber = 0;
+        while (std::getline(file, line))
+        {
+            lineNumber++;
+            std::istringstream in(line);
+            std::string kind;
+            if (!(in >> kind) || kind[0] == '#')
+                continue;
+
+            SceneObject object = SceneObject();
+            object.Texture = -1;
+            std::string name;
+            bool ok = static_cast<bool>(in >> name);
+            if (kind == "wall")
+            {
+                object.Kind = PRIM_WALL;
+                ok = ok && this->readColor(in, object.Color);
+            }
+            else if (kind == "prism")
+            {
+                object.Kind = PRIM_PRISM;
+                object.PointCount = 4;
+                ok = ok && this->readPoints(in, object);
+                ok = ok && (in >> object.ZFront >> object.ZBack);
+                ok = ok && this->readColor(in, object.Color);
+                std::string texture;
+                if (ok && in >> texture)
+                    object.Texture = this->addTexture(texture);
+            }
+            else if (kind == "circle")
+            {
+                object.Kind = PRIM_CIRCLE;
+                object.PointCount = 1;
+                ok = ok && this->readPoints(in, object);
+                ok = ok && (in >> object.Radius >> object.Segments >> object.ZFront);
+                ok = ok && object.Segments > 2 && object.Segments <= MAX_CIRCLE_SEGMENTS;
+                ok = ok && this->readColor(in, object.Color);
+                object.ZBack = object.ZFront;
+            }
+            else if (kind == "lines")
+            {
+                object.Kind = PRIM_LINES;
+                ok = ok && (in >> object.PointCount);
+                ok = ok && object.PointCount >= 2 && object.PointCount <= MAX_OBJECT_POINTS && object.PointCount % 2 == 0;
+                ok = ok && this->readPoints(in, object);
+                ok = ok && (in >> object.ZFront);
+                ok = ok && this->readColor(in, object.Color);
+                object.ZBack = object.ZFront;
+            }
+            else
+            {
+                ok = false;
+            }
+
+            if (!ok)
+            {
+                std::cout << "ERROR::SCENE::PARSE_FAILED: " << path << ":" << lineNumber << "\n" << line << std::endl;
+                this->Objects.clear();
+                this->Names.clear();
+                this->TexturePaths.clear();
+                return false;
+            }
+            this->Objects.push_back(object);
+            this->Names.push_back(name);
+        }
+        return true;
+    }
+
+private:
+    bool readPoints(std::istringstream& in, SceneObject& object)
+    {
+        for (GLint i = 0; i < object.PointCount; ++i)
+        {
+            if (!(in >> object.Points[i].x >> object.Points[i].y))
+                return false;
+        }
+        return true;
+    }
+
+    // Reads a 0-255 RGB triple into an RGBA colour
+    bool readColor(std::istringstream& in, glm::vec4& color)
+    {
+        GLint r, g, b;
+        if (!(in >> r >> g >> b))
+            return false;
+        color = glm::vec4(r / 255.0f, g / 255.0f, b / 255.0f, 1.0f);
+        return true;
+    }
+
+    // Returns the index of path in TexturePaths, adding it if it's new
+    GLint addTexture(const std::string& path)
+    {
+        for (size_t i = 0; i < this->TexturePaths.size(); ++i)
+        {
+            if (this->TexturePaths[i] == path)
+                return (GLint)i;
+        }
+        this->TexturePaths.push_back(path);
+        return (GLint)this->TexturePaths.size() - 1;
+    }
+};
@@ -5,19 +5,158 @@
 #define SHADER_H
 
 #include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <filesystem>
+#include <unordered_map>
 
 #include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// FNV-1a hash of a uniform name, usable at compile time: constexpr GLuint h = UniformHash("model");
+constexpr GLuint UniformHash(const char* name)
+{
+    GLuint hash = 2166136261u;
+    while (*name)
+    {
+        hash ^= (GLuint)(unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
 
 class Shader
 {
 public:
     GLuint Program;
-    // Constructor generates the shader on the fly
-    Shader(const GLchar* vertexPath, const GLchar* fragmentPath)
+    // Linked programs are kept here between runs (GL_ARB_get_program_binary), empty disables the cache
+    static inline std::string BinaryCacheDirectory = "shader_cache";
+
+    // Constructor generates the shader on the fly, defines ("#define NAME\n" lines) are inserted after #version
+    Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const std::string& defines = "")
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines)
+    {
+        this->build(this->Program);
+        this->reflectUniforms();
+    }
+
+    // Builds a compute program from one file instead (OpenGL 4.3)
+    static Shader Compute(const GLchar* computePath, const std::string& defines = "")
+    {
+        Shader shader;
+        shader.computePath = computePath;
+        shader.defines = defines;
+        shader.build(shader.Program);
+        shader.reflectUniforms();
+        return shader;
+    }
+
+    // Recompiles both files into a new program and switches to it only if it links; otherwise the errors are
+    // printed and the current program stays in use. Uniform locations and block bindings are refreshed on success,
+    // uniform values have to be set again by the caller.
+    bool Reload()
+    {
+        GLuint program = 0;
+        if (!this->build(program))
+        {
+            glDeleteProgram(program);
+            std::cout << "ERROR::SHADER::RELOAD_FAILED: keeping the previous program of "
+                      << (this->computePath.empty() ? this->vertexPath + " / " + this->fragmentPath : this->computePath) << std::endl;
+            return false;
+        }
+        glDeleteProgram(this->Program);
+        this->Program = program;
+        this->reflectUniforms();
+        for (const std::pair<std::string, GLuint>& block : this->blockBindings)
+            this->bindBlock(block.first.c_str(), block.second);
+        return true;
+    }
+
+    // True when the program is built from path
+    bool Uses(const std::string& path) const
+    {
+        return !path.empty() && (path == this->vertexPath || path == this->fragmentPath || path == this->computePath);
+    }
+
+    // Uses the current shader
+    void Use() 
+    { 
+        glUseProgram(this->Program); 
+    }
+
+    // Returns the location of an active uniform from the table built at link time, -1 if it doesn't exist.
+    // Look handles up once outside the render loop and pass them to the setters.
+    GLint Uniform(GLuint nameHash) const
+    {
+        std::unordered_map<GLuint, GLint>::const_iterator it = this->uniforms.find(nameHash);
+        return it == this->uniforms.end() ? -1 : it->second;
+    }
+    GLint Uniform(const GLchar* name) const
+    {
+        return this->Uniform(UniformHash(name));
+    }
+
+    // Connects a uniform block of the program to a buffer binding point, blocks the program lacks are ignored
+    void BindUniformBlock(const GLchar* name, GLuint binding)
+    {
+        bool known = false;
+        for (std::pair<std::string, GLuint>& block : this->blockBindings)
+        {
+            if (block.first == name)
+            {
+                block.second = binding;
+                known = true;
+            }
+        }
+        if (!known)
+            this->blockBindings.push_back(std::make_pair(std::string(name), binding));
+        this->bindBlock(name, binding);
+    }
+
+    // Typed setters for the program currently in use, a location of -1 is silently ignored
+    void SetMat4(GLint location, const glm::mat4& value) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+    void SetVec4(GLint location, const glm::vec4& value) const
+    {
+        glUniform4fv(location, 1, glm::value_ptr(value));
+    }
+    void SetInt(GLint location, GLint value) const
     {
+        glUniform1i(location, value);
+    }
+    void SetUInt(GLint location, GLuint value) const
+    {
+        glUniform1ui(location, value);
+    }
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::string computePath;
+    std::string defines;
+
+    // Used by Compute()
+    Shader() : Program(0)
+    {
+    }
+    // Hash of the uniform name -> location
+    std::unordered_map<GLuint, GLint> uniforms;
+    // Kept so a reloaded program gets the same bindings
+    std::vector<std::pair<std::string, GLuint>> blockBindings;
+
+    // Reads, compiles and links the shader files into program, returns false when linking failed
+    bool build(GLuint& program) const
+    {
+        if (!this->computePath.empty())
+            return this->buildCompute(program);
+
         // 1. Retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
@@ -29,8 +168,8 @@ public:
         try
         {
             // Open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
+            vShaderFile.open(this->vertexPath);
+            fShaderFile.open(this->fragmentPath);
             std::stringstream vShaderStream, fShaderStream;
             // Read file's buffer contents into streams
             vShaderStream << vShaderFile.rdbuf();
@@ -46,6 +185,17 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
+        if (!this->defines.empty())
+        {
+            vertexCode = insertDefines(vertexCode, this->defines);
+            fragmentCode = insertDefines(fragmentCode, this->defines);
+        }
+
+        // Reuse the program linked by an earlier run when the driver still accepts it
+        std::string binaryPath = binaryCachePath(vertexCode, fragmentCode);
+        if (!binaryPath.empty() && loadBinary(binaryPath, program))
+            return true;
+
         const GLchar* vShaderCode = vertexCode.c_str();
         const GLchar * fShaderCode = fragmentCode.c_str();
         // 2. Compile shaders
@@ -75,26 +225,193 @@ public:
             std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
         }
         // Shader Program
-        this->Program = glCreateProgram();
-        glAttachShader(this->Program, vertex);
-        glAttachShader(this->Program, fragment);
-        glLinkProgram(this->Program);
+        program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        if (!binaryPath.empty())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
         // Print linking errors if any
-        glGetProgramiv(this->Program, GL_LINK_STATUS, &success);
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
         if (!success)
         {
-            glGetProgramInfoLog(this->Program, 512, NULL, infoLog);
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
             std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
         }
+        else if (!binaryPath.empty())
+        {
+            saveBinary(binaryPath, program);
+        }
         // Delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
+        return success == GL_TRUE;
+    }
+
+    // build() for compute programs
+    bool buildCompute(GLuint& program) const
+    {
+        std::ifstream file(this->computePath);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        std::string computeCode = stream.str();
+        if (computeCode.empty())
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        if (!this->defines.empty())
+            computeCode = insertDefines(computeCode, this->defines);
+
+        std::string binaryPath = binaryCachePath(computeCode, "");
+        if (!binaryPath.empty() && loadBinary(binaryPath, program))
+            return true;
+
+        const GLchar* cShaderCode = computeCode.c_str();
+        GLint success;
+        GLchar infoLog[512];
+        GLuint compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        glGetShaderiv(compute, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(compute, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
+        }
+        program = glCreateProgram();
+        glAttachShader(program, compute);
+        if (!binaryPath.empty())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        }
+        else if (!binaryPath.empty())
+        {
+            saveBinary(binaryPath, program);
+        }
+        glDeleteShader(compute);
+        return success == GL_TRUE;
+    }
 
+    void bindBlock(const GLchar* name, GLuint binding)
+    {
+        GLuint index = glGetUniformBlockIndex(this->Program, name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(this->Program, index, binding);
     }
-    // Uses the current shader
-    void Use() 
-    { 
-        glUseProgram(this->Program); 
+
+    // Cache file of a program: 64-bit FNV-1a of both sources and the driver strings, so editing a shader or
+    // updating the driver misses the cache. Empty when the cache is disabled or the driver can't save binaries.
+    static std::string binaryCachePath(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        if (BinaryCacheDirectory.empty() || !(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary))
+            return "";
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats <= 0)
+            return "";
+
+        uint64_t hash = 14695981039346656037ull;
+        const GLubyte* driver[3] = { glGetString(GL_VENDOR), glGetString(GL_RENDERER), glGetString(GL_VERSION) };
+        std::string key = vertexCode + '\0' + fragmentCode;
+        for (const GLubyte* text : driver)
+            key += '\0' + std::string(text ? (const char*)text : "");
+        for (unsigned char c : key)
+        {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)hash);
+        return BinaryCacheDirectory + name;
+    }
+
+    // Creates the program from a cached binary, false when there is none or the driver rejects it
+    static bool loadBinary(const std::string& path, GLuint& program)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+        GLenum format = 0;
+        file.read((char*)&format, sizeof(format));
+        std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (binary.empty())
+            return false;
+
+        program = glCreateProgram();
+        glProgramBinary(program, format, binary.data(), (GLsizei)binary.size());
+        GLint success = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glDeleteProgram(program);
+            program = 0;
+            return false;
+        }
+        return true;
+    }
+
+    static void saveBinary(const std::string& path, GLuint program)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(BinaryCacheDirectory, error);
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cout << "ERROR::SHADER::BINARY_NOT_WRITTEN: " << path << std::endl;
+            return;
+        }
+        file.write((const char*)&format, sizeof(format));
+        file.write(binary.data(), binary.size());
+    }
+
+    // #version has to stay the first statement, so defines go on the line after it
+    static std::string insertDefines(const std::string& code, const std::string& defines)
+    {
+        size_t version = code.find("#version");
+        size_t lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return defines + code;
+        return code.substr(0, lineEnd + 1) + defines + code.substr(lineEnd + 1);
+    }
+
+    // Queries every active uniform of the linked program once
+    void reflectUniforms()
+    {
+        this->uniforms.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(this->Program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(this->Program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(maxLength > 0 ? maxLength : 1, '\0');
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei length = 0;
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(this->Program, (GLuint)i, maxLength, &length, &size, &type, &name[0]);
+            std::string uniformName = name.substr(0, length);
+            // Arrays are reported as "name[0]", register them under their plain name
+            if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+                uniformName.resize(uniformName.size() - 3);
+            GLint location = glGetUniformLocation(this->Program, uniformName.c_str());
+            // Uniforms inside blocks have no location
+            if (location < 0)
+                continue;
+            GLuint hash = UniformHash(uniformName.c_str());
+            if (this->uniforms.count(hash))
+                std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION: " << uniformName << std::endl;
+            this->uniforms[hash] = location;
+        }
     }
 };
 
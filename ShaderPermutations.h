@@ -0,0 +1,93 @@
+#pragma once
+
+// Std. Includes
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+// GL Includes
+#include <GL/glew.h>
+
+#include "Shader.h"
+
+
+// Features a shader variant is compiled with, combined into a permutation key
+enum Shader_Feature
+{
+    SHADER_TEXTURED  = 1 << 0, // sample the texture array instead of a solid colour
+    SHADER_LIT       = 1 << 1, // shade with a fixed directional light
+    SHADER_OBJECT_ID = 1 << 2  // write the object ID to colour attachment 1 and tint the hovered object
+};
+
+// Compiles variants of one vertex/fragment shader pair, each with the #defines of its feature bits
+// (TEXTURED, LIT, OBJECT_ID), and caches them by key. Variants are compiled on first use, so
+// request every key a scene needs before rendering starts.
+class ShaderPermutations
+{
+public:
+    // Runs once for every newly compiled variant, e.g. to bind uniform blocks and set samplers
+    std::function<void(Shader&)> OnCompile;
+
+    ShaderPermutations(const GLchar* vertexPath, const GLchar* fragmentPath)
+        : vertexPath(vertexPath), fragmentPath(fragmentPath)
+    {
+    }
+
+    Shader& Get(GLuint features)
+    {
+        std::unordered_map<GLuint, Shader>::iterator it = this->variants.find(features);
+        if (it != this->variants.end())
+            return it->second;
+
+        it = this->variants.emplace(features, Shader(this->vertexPath.c_str(), this->fragmentPath.c_str(), Defines(features))).first;
+        if (this->OnCompile)
+            this->OnCompile(it->second);
+        return it->second;
+    }
+
+    // The #define lines of a key
+    static std::string Defines(GLuint features)
+    {
+        std::string defines;
+        if (features & SHADER_TEXTURED)
+            defines += "#define TEXTURED\n";
+        if (features & SHADER_LIT)
+            defines += "#define LIT\n";
+        if (features & SHADER_OBJECT_ID)
+            defines += "#define OBJECT_ID\n";
+        return defines;
+    }
+
+    // Rebuilds every variant compiled from path, returns how many were swapped in. Variants that fail to
+    // link keep their previous program. OnCompile runs again for the new programs.
+    int Reload(const std::string& path)
+    {
+        int reloaded = 0;
+        for (std::pair<const GLuint, Shader>& variant : this->variants)
+        {
+            if (!variant.second.Uses(path) || !variant.second.Reload())
+                continue;
+            if (this->OnCompile)
+                this->OnCompile(variant.second);
+            reloaded++;
+        }
+        return reloaded;
+    }
+
+    size_t Count() const
+    {
+        return this->variants.size();
+    }
+
+    void Release()
+    {
+        for (std::pair<const GLuint, Shader>& variant : this->variants)
+            glDeleteProgram(variant.second.Program);
+        this->variants.clear();
+    }
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::unordered_map<GLuint, Shader> variants;
+};
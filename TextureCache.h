@@ -0,0 +1,429 @@
+#pragma once
+
+// Std. Includes
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// GL Includes
+#include <GL/glew.h>
+
+
+// One mip level of a cached texture
+struct TextureLevel
+{
+    GLsizei Width;
+    GLsizei Height;
+    std::vector<unsigned char> Data;
+};
+
+// A texture as stored in the cache: a full mip chain, block compressed or RGBA8
+struct CachedTexture
+{
+    GLenum InternalFormat = GL_RGBA8;
+    bool Compressed = false;
+    std::vector<TextureLevel> Levels;
+};
+
+// Cooked textures are KTX2 files named after a hash of the source image's bytes, so editing a source
+// image invalidates its entry without any bookkeeping. The cooker (cook.cpp) resizes images to LAYER_SIZE
+// squared and writes BC1 for opaque images and RGBA8 for images with alpha, always with a precomputed mip
+// chain. Readers get BC1 data as is when the driver can sample it, BC1 is decoded back to RGBA8 otherwise.
+class TextureCache
+{
+public:
+    // Width and height textures are cooked at, every layer of the texture array has this size
+    static const int LAYER_SIZE = 1024;
+
+    // Vulkan format numbers used in the KTX2 header
+    static const uint32_t VK_FORMAT_R8G8B8A8_UNORM = 37;
+    static const uint32_t VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131;
+
+    static bool ReadFile(const std::string& path, std::vector<unsigned char>& bytes)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return !file.bad();
+    }
+
+    // 64-bit FNV-1a of the source file contents
+    static uint64_t ContentHash(const std::vector<unsigned char>& bytes)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char b : bytes)
+        {
+            hash ^= b;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static std::string EntryPath(const std::string& directory, uint64_t hash)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.ktx2", (unsigned long long)hash);
+        return directory + name;
+    }
+
+    // True when every texel of an RGBA8 image has full alpha
+    static bool Opaque(const unsigned char* rgba, int width, int height)
+    {
+        for (size_t i = 0; i < (size_t)width * height; ++i)
+        {
+            if (rgba[i * 4 + 3] != 255)
+                return false;
+        }
+        return true;
+    }
+
+    // Area-averaging resample of an RGBA8 image
+    static std::vector<unsigned char> Resize(const unsigned char* rgba, int width, int height, int newWidth, int newHeight)
+    {
+        std::vector<unsigned char> out((size_t)newWidth * newHeight * 4);
+        for (int y = 0; y < newHeight; ++y)
+        {
+            int y0 = (int)((long long)y * height / newHeight);
+            int y1 = std::max((int)((long long)(y + 1) * height / newHeight), y0 + 1);
+            for (int x = 0; x < newWidth; ++x)
+            {
+                int x0 = (int)((long long)x * width / newWidth);
+                int x1 = std::max((int)((long long)(x + 1) * width / newWidth), x0 + 1);
+                unsigned sum[4] = { 0, 0, 0, 0 };
+                for (int sy = y0; sy < y1; ++sy)
+                {
+                    for (int sx = x0; sx < x1; ++sx)
+                    {
+                        for (int c = 0; c < 4; ++c)
+                            sum[c] += rgba[((size_t)sy * width + sx) * 4 + c];
+                    }
+                }
+                unsigned count = (unsigned)((y1 - y0) * (x1 - x0));
+                for (int c = 0; c < 4; ++c)
+                    out[((size_t)y * newWidth + x) * 4 + c] = (unsigned char)((sum[c] + count / 2) / count);
+            }
+        }
+        return out;
+    }
+
+    // Builds the mip chain of an RGBA8 image, BC1 encoded when compress is set (alpha is dropped)
+    static CachedTexture Cook(const unsigned char* rgbaPixels, int width, int height, bool compress)
+    {
+        std::vector<unsigned char> rgba(rgbaPixels, rgbaPixels + (size_t)width * height * 4);
+        CachedTexture texture;
+        texture.Compressed = compress;
+        texture.InternalFormat = compress ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+        GLsizei w = width, h = height;
+        for (;;)
+        {
+            TextureLevel level;
+            level.Width = w;
+            level.Height = h;
+            level.Data = compress ? encodeBC1(rgba.data(), w, h) : rgba;
+            texture.Levels.push_back(std::move(level));
+            if (w == 1 && h == 1)
+                break;
+            rgba = downsample(rgba, w, h);
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+        }
+        return texture;
+    }
+
+    static bool Write(const std::string& path, const CachedTexture& texture)
+    {
+        uint32_t vkFormat = texture.Compressed ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_R8G8B8A8_UNORM;
+        uint32_t alignment = texture.Compressed ? 8 : 4;
+        std::vector<uint32_t> dfd = descriptor(texture.Compressed);
+        uint32_t levelCount = (uint32_t)texture.Levels.size();
+
+        // Header, index, level index, then the descriptor; level data follows, smallest level first
+        const size_t headerSize = 80;
+        size_t dfdOffset = headerSize + levelCount * 24;
+        size_t offset = dfdOffset + dfd.size() * 4;
+        std::vector<uint64_t> levelOffsets(levelCount);
+        for (size_t i = levelCount; i-- > 0;)
+        {
+            offset = (offset + alignment - 1) / alignment * alignment;
+            levelOffsets[i] = offset;
+            offset += texture.Levels[i].Data.size();
+        }
+
+        std::vector<unsigned char> file(offset, 0);
+        memcpy(file.data(), IDENTIFIER, sizeof(IDENTIFIER));
+        uint32_t header[9] = { vkFormat, 1, (uint32_t)texture.Levels[0].Width, (uint32_t)texture.Levels[0].Height,
+                               0, 0, 1, levelCount, 0 };
+        memcpy(&file[12], header, sizeof(header));
+        uint32_t index[4] = { (uint32_t)dfdOffset, (uint32_t)(dfd.size() * 4), 0, 0 };
+        memcpy(&file[48], index, sizeof(index));
+        for (uint32_t i = 0; i < levelCount; ++i)
+        {
+            uint64_t entry[3] = { levelOffsets[i], texture.Levels[i].Data.size(), texture.Levels[i].Data.size() };
+            memcpy(&file[headerSize + i * 24], entry, sizeof(entry));
+            memcpy(&file[levelOffsets[i]], texture.Levels[i].Data.data(), texture.Levels[i].Data.size());
+        }
+        memcpy(&file[dfdOffset], dfd.data(), dfd.size() * 4);
+
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open())
+            return false;
+        out.write((const char*)file.data(), file.size());
+        return out.good();
+    }
+
+    // Reads a cache entry. BC1 data is decoded to RGBA8 unless supportsBC1.
+    static bool Read(const std::string& path, bool supportsBC1, CachedTexture& texture)
+    {
+        std::vector<unsigned char> file;
+        if (!ReadFile(path, file) || file.size() < 80 || memcmp(file.data(), IDENTIFIER, sizeof(IDENTIFIER)) != 0)
+            return false;
+        uint32_t header[9];
+        memcpy(header, &file[12], sizeof(header));
+        uint32_t vkFormat = header[0], levelCount = std::max(header[7], 1u);
+        // Only plain 2D textures without supercompression are produced by the cooker
+        if (header[4] > 1 || header[5] != 0 || header[6] != 1 || header[8] != 0 || file.size() < 80 + levelCount * 24)
+            return false;
+
+        bool bc1 = vkFormat == VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        if (!bc1 && vkFormat != VK_FORMAT_R8G8B8A8_UNORM)
+            return false;
+        bool decode = bc1 && !supportsBC1;
+        texture.Compressed = bc1 && !decode;
+        texture.InternalFormat = texture.Compressed ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+        texture.Levels.clear();
+
+        for (uint32_t i = 0; i < levelCount; ++i)
+        {
+            uint64_t entry[3];
+            memcpy(entry, &file[80 + i * 24], sizeof(entry));
+            TextureLevel level;
+            level.Width = std::max((GLsizei)(header[2] >> i), 1);
+            level.Height = std::max((GLsizei)(header[3] >> i), 1);
+            size_t expected = bc1 ? (size_t)((level.Width + 3) / 4) * ((level.Height + 3) / 4) * 8
+                                : (size_t)level.Width * level.Height * 4;
+            if (entry[1] != expected || entry[0] + entry[1] > file.size())
+                return false;
+            level.Data.assign(file.begin() + entry[0], file.begin() + entry[0] + entry[1]);
+            if (decode)
+                level.Data = DecodeBC1(level.Data.data(), level.Width, level.Height);
+            texture.Levels.push_back(std::move(level));
+        }
+        return true;
+    }
+
+    static std::vector<unsigned char> DecodeBC1(const unsigned char* blocks, int width, int height)
+    {
+        int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        std::vector<unsigned char> out((size_t)width * height * 4);
+        for (int by = 0; by < blocksY; ++by)
+        {
+            for (int bx = 0; bx < blocksX; ++bx)
+            {
+                const unsigned char* block = blocks + ((size_t)by * blocksX + bx) * 8;
+                uint16_t c0 = block[0] | (block[1] << 8), c1 = block[2] | (block[3] << 8);
+                uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+                int colors[4][3];
+                palette(c0, c1, colors);
+                for (int i = 0; i < 16; ++i)
+                {
+                    int x = bx * 4 + i % 4, y = by * 4 + i / 4;
+                    if (x >= width || y >= height)
+                        continue;
+                    const int* color = colors[(indices >> (i * 2)) & 3];
+                    unsigned char* texel = &out[((size_t)y * width + x) * 4];
+                    texel[0] = (unsigned char)color[0];
+                    texel[1] = (unsigned char)color[1];
+                    texel[2] = (unsigned char)color[2];
+                    texel[3] = 255;
+                }
+            }
+        }
+        return out;
+    }
+
+    // One BC1 block of a single colour given as 0-255 components
+    static void SolidBC1(const float* rgb, unsigned char block[8])
+    {
+        uint16_t c = toRGB565(rgb);
+        block[0] = block[2] = c & 0xFF;
+        block[1] = block[3] = c >> 8;
+        block[4] = block[5] = block[6] = block[7] = 0;
+    }
+
+private:
+    static constexpr unsigned char IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+    // Khronos basic data format descriptor for BC1 RGB or R8G8B8A8 (linear, BT.709 primaries)
+    static std::vector<uint32_t> descriptor(bool bc1)
+    {
+        uint32_t samples = bc1 ? 1 : 4;
+        uint32_t blockSize = 24 + 16 * samples;
+        std::vector<uint32_t> dfd = {
+            4 + blockSize,                  // dfdTotalSize
+            0,                              // vendorId, descriptorType
+            2 | (blockSize << 16),          // versionNumber, descriptorBlockSize
+            (bc1 ? 128u : 1u) | (1 << 8) | (1 << 16), // colorModel BC1A / RGBSDA, primaries BT709, transfer linear
+            bc1 ? (3u | (3u << 8)) : 0u,    // texel block dimensions - 1
+            bc1 ? 8u : 4u,                  // bytesPlane0
+            0
+        };
+        if (bc1)
+        {
+            dfd.insert(dfd.end(), { 0u | (63u << 16), 0u, 0u, 0xFFFFFFFFu });
+        }
+        else
+        {
+            const uint32_t channels[4] = { 0, 1, 2, 15 };
+            for (uint32_t c = 0; c < 4; ++c)
+                dfd.insert(dfd.end(), { c * 8 | (7u << 16) | (channels[c] << 24), 0u, 0u, 255u });
+        }
+        return dfd;
+    }
+
+    // 2x2 box filter, odd edges reuse their last row/column
+    static std::vector<unsigned char> downsample(const std::vector<unsigned char>& rgba, int width, int height)
+    {
+        int w = std::max(width / 2, 1), h = std::max(height / 2, 1);
+        std::vector<unsigned char> out((size_t)w * h * 4);
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+                for (int c = 0; c < 4; ++c)
+                {
+                    int sum = rgba[((size_t)y0 * width + x0) * 4 + c] + rgba[((size_t)y0 * width + x1) * 4 + c] +
+                              rgba[((size_t)y1 * width + x0) * 4 + c] + rgba[((size_t)y1 * width + x1) * 4 + c];
+                    out[((size_t)y * w + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        return out;
+    }
+
+    static uint16_t toRGB565(const float* c)
+    {
+        int r = (int)(std::min(std::max(c[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+        int g = (int)(std::min(std::max(c[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+        int b = (int)(std::min(std::max(c[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    static void fromRGB565(uint16_t v, int* c)
+    {
+        c[0] = ((v >> 11) & 31) * 255 / 31;
+        c[1] = ((v >> 5) & 63) * 255 / 63;
+        c[2] = (v & 31) * 255 / 31;
+    }
+
+    // The 4 colours of a BC1 block, 3 plus black when c0 <= c1
+    static void palette(uint16_t c0, uint16_t c1, int colors[4][3])
+    {
+        fromRGB565(c0, colors[0]);
+        fromRGB565(c1, colors[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            if (c0 > c1)
+            {
+                colors[2][c] = (2 * colors[0][c] + colors[1][c]) / 3;
+                colors[3][c] = (colors[0][c] + 2 * colors[1][c]) / 3;
+            }
+            else
+            {
+                colors[2][c] = (colors[0][c] + colors[1][c]) / 2;
+                colors[3][c] = 0;
+            }
+        }
+    }
+
+    // Principal-axis BC1 encoder: the endpoints are the block's extreme colours along the axis of greatest variance
+    static std::vector<unsigned char> encodeBC1(const unsigned char* rgba, int width, int height)
+    {
+        int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        std::vector<unsigned char> out((size_t)blocksX * blocksY * 8);
+        for (int by = 0; by < blocksY; ++by)
+        {
+            for (int bx = 0; bx < blocksX; ++bx)
+            {
+                float texels[16][3];
+                float mean[3] = { 0.0f, 0.0f, 0.0f };
+                for (int i = 0; i < 16; ++i)
+                {
+                    int x = std::min(bx * 4 + i % 4, width - 1), y = std::min(by * 4 + i / 4, height - 1);
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        texels[i][c] = rgba[((size_t)y * width + x) * 4 + c];
+                        mean[c] += texels[i][c] / 16.0f;
+                    }
+                }
+
+                float cov[6] = {};
+                for (int i = 0; i < 16; ++i)
+                {
+                    float d[3] = { texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2] };
+                    cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+                    cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+                }
+                float axis[3] = { 1.0f, 1.0f, 1.0f };
+                for (int iteration = 0; iteration < 8; ++iteration)
+                {
+                    float next[3] = { cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                                      cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                                      cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+                    float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+                    if (length < 1e-6f)
+                        break;
+                    for (int c = 0; c < 3; ++c)
+                        axis[c] = next[c] / length;
+                }
+
+                int lo = 0, hi = 0;
+                float loDot = 1e30f, hiDot = -1e30f;
+                for (int i = 0; i < 16; ++i)
+                {
+                    float dot = texels[i][0] * axis[0] + texels[i][1] * axis[1] + texels[i][2] * axis[2];
+                    if (dot < loDot) { loDot = dot; lo = i; }
+                    if (dot > hiDot) { hiDot = dot; hi = i; }
+                }
+                uint16_t c0 = toRGB565(texels[hi]), c1 = toRGB565(texels[lo]);
+                if (c0 < c1)
+                    std::swap(c0, c1);
+
+                // Equal endpoints select colour 0 everywhere; otherwise pick the nearest of the 4 colours
+                uint32_t indices = 0;
+                if (c0 != c1)
+                {
+                    int colors[4][3];
+                    palette(c0, c1, colors);
+                    for (int i = 0; i < 16; ++i)
+                    {
+                        int best = 0;
+                        float bestError = 1e30f;
+                        for (int p = 0; p < 4; ++p)
+                        {
+                            float error = 0.0f;
+                            for (int c = 0; c < 3; ++c)
+                                error += (texels[i][c] - colors[p][c]) * (texels[i][c] - colors[p][c]);
+                            if (error < bestError) { bestError = error; best = p; }
+                        }
+                        indices |= (uint32_t)best << (i * 2);
+                    }
+                }
+
+                unsigned char* block = &out[((size_t)by * blocksX + bx) * 8];
+                block[0] = c0 & 0xFF; block[1] = c0 >> 8;
+                block[2] = c1 & 0xFF; block[3] = c1 >> 8;
+                for (int b = 0; b < 4; ++b)
+                    block[4 + b] = (indices >> (b * 8)) & 0xFF;
+            }
+        }
+        return out;
+    }
+};
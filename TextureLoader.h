@@ -0,0 +1,415 @@
+#pragma once
+
+// Std. Includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "stb_image.h"
+#include "TextureCache.h"
+#include "Trace.h"
+
+
+// Unbounded multiple-producer single-consumer queue. Producers append with one atomic exchange and
+// never wait on each other or on the consumer; only the consumer thread may call Pop().
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() : head(new Node), tail(head.load()) {}
+
+    ~MpscQueue()
+    {
+        T value;
+        while (this->Pop(value)) {}
+        delete this->tail;
+    }
+
+    void Push(T value)
+    {
+        Node* node = new Node;
+        node->Value = std::move(value);
+        Node* previous = this->head.exchange(node, std::memory_order_acq_rel);
+        previous->Next.store(node, std::memory_order_release);
+    }
+
+    // Returns false when nothing has been fully pushed yet
+    bool Pop(T& value)
+    {
+        Node* next = this->tail->Next.load(std::memory_order_acquire);
+        if (!next)
+            return false;
+        value = std::move(next->Value);
+        delete this->tail;
+        this->tail = next;
+        return true;
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> Next{nullptr};
+        T Value;
+    };
+
+    std::atomic<Node*> head;
+    Node* tail;
+};
+
+// Loads every texture of a scene into the layers of one GL_TEXTURE_2D_ARRAY without blocking the GL thread,
+// so drawing textured objects needs no texture binds: objects select their layer instead.
+// Load() reserves a layer and fills it with a placeholder colour right away; worker threads look the file up in
+// the TextureCache by content hash or decode it with stb_image on a miss, bring it to the layer size and format
+// (BC1 when the driver supports it, RGBA8 otherwise), and hand it back through an MpscQueue. Update() streams it
+// into the layer through a pixel unpack buffer. Texture coordinates stay 0-1 per layer.
+// Every GL call happens on the thread owning the context: the constructor, Load(), Update(), Finish(), Release().
+class TextureLoader
+{
+public:
+    static const GLsizei LAYER_SIZE = TextureCache::LAYER_SIZE;
+    // Bytes uploaded by one Update() before the rest is left for the next frame
+    static const size_t UPLOAD_BUDGET = 8 << 20;
+
+    // Allocates an array of layers textures (none when 0). Cooked textures are looked up in
+    // cacheDirectory (empty disables the cache). threads = 0 picks one worker per spare core, at most 4.
+    // The workers are started by the first Load(), so a scene without textures runs no threads.
+    explicit TextureLoader(GLsizei layers, const std::string& cacheDirectory = "texture_cache", unsigned threads = 0)
+        : layers(layers), cacheDirectory(cacheDirectory)
+    {
+        // Workers can't query GL, so the layer format is chosen here
+        this->compressed = GLEW_EXT_texture_compression_s3tc;
+        if (layers > 0)
+            this->allocate();
+
+        if (threads == 0)
+            threads = std::min(std::max(std::thread::hardware_concurrency(), 2u) - 1, 4u);
+        this->threads = threads;
+    }
+
+    ~TextureLoader()
+    {
+        this->stopWorkers();
+    }
+
+    // Reserves the next layer, fills it with placeholder and queues path for loading.
+    // Returns the layer, or -1 when every layer is taken.
+    GLint Load(const std::string& path, const glm::vec4& placeholder)
+    {
+        if (this->nextLayer >= this->layers)
+        {
+            std::cerr << "ERROR::TEXTURE::NO_FREE_LAYER: " << path << std::endl;
+            return -1;
+        }
+        GLint layer = this->nextLayer++;
+        this->fill(layer, placeholder);
+
+        if (this->workers.empty())
+            this->startWorkers();
+        {
+            std::lock_guard<std::mutex> lock(this->jobMutex);
+            this->jobs.push_back(Image{ layer, path, CachedTexture() });
+        }
+        this->jobReady.notify_one();
+        this->pending++;
+        return layer;
+    }
+
+    // Binds the array to a texture unit
+    void Bind(GLuint unit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, this->texture);
+    }
+
+    // Uploads loaded images until budget bytes have been sent, call once per frame.
+    // Returns the number of layers that changed.
+    int Update(size_t budget = UPLOAD_BUDGET)
+    {
+        TRACE_SCOPE("TextureLoader::Update");
+        size_t uploaded = 0;
+        int layers = 0;
+        Image image;
+        while (uploaded < budget && this->decoded.Pop(image))
+        {
+            this->pending--;
+            if (image.Texture.Levels.empty())
+            {
+                std::cerr << "Texture failed to load at path: " << image.Path << std::endl;
+                continue;
+            }
+            uploaded += this->upload(image);
+            this->resident.insert(image.Layer);
+            layers++;
+        }
+        return layers;
+    }
+
+    // Blocks until every requested texture has been uploaded (or failed), used by the scripted runs
+    void Finish()
+    {
+        while (this->pending > 0)
+        {
+            this->Update(SIZE_MAX);
+            if (this->pending > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // True once the layer holds the loaded image instead of the placeholder
+    bool Resident(GLint layer) const
+    {
+        return this->resident.count(layer) != 0;
+    }
+
+    // Number of textures requested but not uploaded yet
+    int Pending() const
+    {
+        return this->pending;
+    }
+
+    GLuint Texture() const
+    {
+        return this->texture;
+    }
+
+    void Release()
+    {
+        this->stopWorkers();
+        glDeleteBuffers(1, &this->pbo);
+        glDeleteTextures(1, &this->texture);
+        this->pbo = this->texture = 0;
+    }
+
+private:
+    struct Image
+    {
+        GLint Layer;
+        std::string Path;
+        CachedTexture Texture; // full mip chain in the array's format, empty when loading failed
+    };
+
+    GLsizei layers;
+    GLint nextLayer = 0;
+    GLuint texture = 0;
+    GLuint pbo = 0;
+    bool compressed = false;
+    std::string cacheDirectory;
+    unsigned threads;
+    std::vector<std::thread> workers;
+    std::deque<Image> jobs;
+    std::mutex jobMutex;
+    std::condition_variable jobReady;
+    bool stopping = false;
+    MpscQueue<Image> decoded;
+    std::unordered_set<GLint> resident;
+    int pending = 0;
+
+    static GLsizei levelCount()
+    {
+        GLsizei count = 1;
+        for (GLsizei size = LAYER_SIZE; size > 1; size /= 2)
+            count++;
+        return count;
+    }
+
+    static GLsizei levelSize(GLsizei level, bool compressed)
+    {
+        GLsizei side = std::max(LAYER_SIZE >> level, 1);
+        return compressed ? ((side + 3) / 4) * ((side + 3) / 4) * 8 : side * side * 4;
+    }
+
+    void allocate()
+    {
+        GLenum format = this->compressed ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+        glGenTextures(1, &this->texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, this->texture);
+        for (GLsizei level = 0; level < levelCount(); ++level)
+        {
+            GLsizei side = std::max(LAYER_SIZE >> level, 1);
+            if (this->compressed)
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, side, side, this->layers, 0,
+                                       levelSize(level, true) * this->layers, nullptr);
+            else
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, side, side, this->layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount() - 1);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    // Sets every level of a layer to one colour
+    void fill(GLint layer, const glm::vec4& color)
+    {
+        float rgb[3] = { color.r * 255.0f, color.g * 255.0f, color.b * 255.0f };
+        unsigned char texel[8];
+        GLsizei texelSize = this->compressed ? 8 : 4;
+        if (this->compressed)
+        {
+            TextureCache::SolidBC1(rgb, texel);
+        }
+        else
+        {
+            for (int c = 0; c < 4; ++c)
+                texel[c] = (unsigned char)(glm::clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+        std::vector<unsigned char> data(levelSize(0, this->compressed));
+        for (size_t i = 0; i < data.size(); i += texelSize)
+            memcpy(&data[i], texel, texelSize);
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, this->texture);
+        for (GLsizei level = 0; level < levelCount(); ++level)
+            this->setLayerLevel(layer, level, data.data());
+    }
+
+    // Writes one level of a layer from client memory or, with an unpack buffer bound, from an offset into it
+    void setLayerLevel(GLint layer, GLsizei level, const GLvoid* source)
+    {
+        GLsizei side = std::max(LAYER_SIZE >> level, 1);
+        if (this->compressed)
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, side, side, 1, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                                      levelSize(level, true), source);
+        else
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, side, side, 1, GL_RGBA, GL_UNSIGNED_BYTE, source);
+    }
+
+    // Worker thread: loads queued files until the loader is stopped
+    void work()
+    {
+        for (;;)
+        {
+            Image image;
+            {
+                std::unique_lock<std::mutex> lock(this->jobMutex);
+                this->jobReady.wait(lock, [this] { return this->stopping || !this->jobs.empty(); });
+                if (this->stopping)
+                    return;
+                image = this->jobs.front();
+                this->jobs.pop_front();
+            }
+            TRACE_SCOPE("loadTexture");
+            this->prepare(image);
+            this->decoded.Push(std::move(image));
+        }
+    }
+
+    // Fills image.Texture with a LAYER_SIZE mip chain in the array's format
+    void prepare(Image& image)
+    {
+        std::vector<unsigned char> bytes;
+        if (!TextureCache::ReadFile(image.Path, bytes))
+            return;
+
+        // A cooked entry of the right size and format is used as is
+        CachedTexture cached;
+        if (!this->cacheDirectory.empty() &&
+            TextureCache::Read(TextureCache::EntryPath(this->cacheDirectory, TextureCache::ContentHash(bytes)),
+                               this->compressed, cached))
+        {
+            if (cached.Compressed == this->compressed && cached.Levels[0].Width == LAYER_SIZE &&
+                cached.Levels[0].Height == LAYER_SIZE && (GLsizei)cached.Levels.size() == levelCount())
+            {
+                image.Texture = std::move(cached);
+                return;
+            }
+        }
+
+        // Otherwise start from RGBA8 pixels: the cached top level if there is one, else the decoded source
+        std::vector<unsigned char> rgba;
+        int width = 0, height = 0;
+        if (!cached.Levels.empty())
+        {
+            width = cached.Levels[0].Width;
+            height = cached.Levels[0].Height;
+            rgba = cached.Compressed ? TextureCache::DecodeBC1(cached.Levels[0].Data.data(), width, height)
+                                     : std::move(cached.Levels[0].Data);
+        }
+        else
+        {
+            int components;
+            unsigned char* pixels = stbi_load_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &components, 4);
+            if (!pixels)
+                return;
+            rgba.assign(pixels, pixels + (size_t)width * height * 4);
+            stbi_image_free(pixels);
+        }
+        if (width != LAYER_SIZE || height != LAYER_SIZE)
+            rgba = TextureCache::Resize(rgba.data(), width, height, LAYER_SIZE, LAYER_SIZE);
+        image.Texture = TextureCache::Cook(rgba.data(), LAYER_SIZE, LAYER_SIZE, this->compressed);
+    }
+
+    void startWorkers()
+    {
+        for (unsigned i = 0; i < this->threads; ++i)
+            this->workers.emplace_back(&TextureLoader::work, this);
+    }
+
+    void stopWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->jobMutex);
+            this->stopping = true;
+        }
+        this->jobReady.notify_all();
+        for (std::thread& worker : this->workers)
+            worker.join();
+        this->workers.clear();
+    }
+
+    // Copies the mip chain into the unpack buffer and fills the layer from it, returns the bytes sent
+    size_t upload(const Image& image)
+    {
+        const std::vector<TextureLevel>& levels = image.Texture.Levels;
+        size_t size = 0;
+        for (const TextureLevel& level : levels)
+            size += level.Data.size();
+
+        if (this->pbo == 0)
+            glGenBuffers(1, &this->pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->pbo);
+        // Orphaning the previous storage lets the driver keep transferring it while this copy is written
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped)
+        {
+            size_t offset = 0;
+            for (const TextureLevel& level : levels)
+            {
+                memcpy(mapped + offset, level.Data.data(), level.Data.size());
+                offset += level.Data.size();
+            }
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        else
+        {
+            // Mapping failed, upload straight from client memory
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, this->texture);
+        size_t offset = 0;
+        for (size_t i = 0; i < levels.size(); ++i)
+        {
+            this->setLayerLevel(image.Layer, (GLsizei)i, mapped ? (const GLvoid*)(uintptr_t)offset : levels[i].Data.data());
+            offset += levels[i].Data.size();
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return size;
+    }
+};
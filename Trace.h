@@ -0,0 +1,127 @@
+#pragma once
+
+// CPU trace instrumentation that writes chrome://tracing / Perfetto JSON.
+// Compile with -DENABLE_TRACING to record, otherwise every macro expands to nothing.
+//   TRACE_SCOPE("name");            times the enclosing block
+//   TRACE_BEGIN("name"); TRACE_END("name");
+//   TRACE_FLUSH("trace.json");      writes the recorded events
+// Names must be string literals (only the pointer is stored).
+
+#ifdef ENABLE_TRACING
+
+// Std. Includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+
+// Fixed-size ring of begin/end events. Threads claim slots with one atomic increment, so recording
+// never takes a lock; when the ring wraps the oldest events are overwritten.
+class Tracer
+{
+public:
+    static const uint64_t CAPACITY = 1 << 16; // power of two
+
+    static Tracer& Instance()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    void Record(const char* name, char phase)
+    {
+        uint64_t index = this->head.fetch_add(1, std::memory_order_relaxed);
+        Event& e = this->events[index & (CAPACITY - 1)];
+        e.Sequence.store(0, std::memory_order_relaxed);
+        e.Name = name;
+        e.Phase = phase;
+        e.Thread = threadId();
+        e.Timestamp = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - this->start).count();
+        // Publishing the sequence number marks the slot as complete
+        e.Sequence.store(index + 1, std::memory_order_release);
+    }
+
+    // Writes every event still in the ring, oldest first
+    bool Flush(const char* path)
+    {
+        std::ofstream file(path);
+        if (!file.is_open())
+        {
+            std::cout << "ERROR::TRACE::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        uint64_t end = this->head.load(std::memory_order_acquire);
+        uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+        file << "{\"traceEvents\":[\n";
+        bool first = true;
+        for (uint64_t index = begin; index < end; ++index)
+        {
+            const Event& e = this->events[index & (CAPACITY - 1)];
+            // Skip slots still being written or already reused
+            if (e.Sequence.load(std::memory_order_acquire) != index + 1)
+                continue;
+            file << (first ? "" : ",\n") << "{\"name\":\"" << e.Name << "\",\"ph\":\"" << e.Phase
+                 << "\",\"ts\":" << e.Timestamp << ",\"pid\":1,\"tid\":" << e.Thread << "}";
+            first = false;
+        }
+        file << "\n]}\n";
+        return file.good();
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Event
+    {
+        std::atomic<uint64_t> Sequence{0};
+        const char* Name;
+        char Phase;
+        uint32_t Thread;
+        long long Timestamp;
+    };
+
+    Event events[CAPACITY];
+    std::atomic<uint64_t> head{0};
+    Clock::time_point start = Clock::now();
+
+    // Small sequential id per thread, easier to read in the trace viewer than native ids
+    static uint32_t threadId()
+    {
+        static std::atomic<uint32_t> next{1};
+        thread_local uint32_t id = next.fetch_add(1);
+        return id;
+    }
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name) : name(name)
+    {
+        Tracer::Instance().Record(this->name, 'B');
+    }
+    ~TraceScope()
+    {
+        Tracer::Instance().Record(this->name, 'E');
+    }
+
+private:
+    const char* name;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_BEGIN(name) Tracer::Instance().Record(name, 'B')
+#define TRACE_END(name) Tracer::Instance().Record(name, 'E')
+#define TRACE_FLUSH(path) Tracer::Instance().Flush(path)
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_FLUSH(path) ((void)0)
+
+#endif
@@ -11,6 +11,11 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -18,145 +23,217 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
 
 #include "Shader.h"
+#include "ShaderPermutations.h"
+#include "Scene.h"
+#include "GeometryPool.h"
+#include "BatchRenderer.h"
+#include "Bounds.h"
+#include "BVH.h"
+#include "HiZCuller.h"
+#include "OcclusionBuffer.h"
+#include "Picker.h"
+#include "ObjectIdReadback.h"
+#include "FrameUniforms.h"
+#include "Framebuffer.h"
+#include "Camera.h"
+#include "CameraPath.h"
+#include "Benchmark.h"
+#include "GpuProfiler.h"
+#include "Trace.h"
+#include "TextureLoader.h"
+#include "FileWatcher.h"
+#include "FixedTimestep.h"
+#include "LinearArena.h"
+// After every header that includes stb_image.h, so the implementation is only compiled here
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
 
 
 //Size of window
 const GLuint WIDTH = 702, HEIGHT = 1062;
 
-// initial camera position
-glm::vec3 cameraPos   = glm::vec3(0.0f, 0.0f, 5.0f);
-glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
-glm::vec3 cameraUp    = glm::vec3(0.0f, 1.0f, 0.0f);
-
-// initial Camera rotation
-float yaw   = -90.0f; // start facing -Z
-float pitch = 0.0f;
+// initial camera position and rotation
+const glm::vec3 initialCameraPos = glm::vec3(0.0f, 0.0f, 5.0f);
+const float initialYaw   = -90.0f; // start facing -Z
+const float initialPitch = 0.0f;
 
-
-glm::vec3 initialCameraPos   = cameraPos;
-glm::vec3 initialCameraFront = cameraFront;
-float initialYaw   = -90.0f; 
-float initialPitch = 0.0f;
+// Simulated camera, moved by the fixed-timestep loop and the callbacks
+Camera camera(initialCameraPos, glm::vec3(0.0f, 1.0f, 0.0f), initialYaw, initialPitch);
 
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-GLuint loadTexture(const char* path);
+void refresh_callback(GLFWwindow* window);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void cursor_pos_callback(GLFWwindow* window, double x, double y);
+
+// Set when the window system asks for the contents to be redrawn (exposed, restored, resized)
+bool windowDamaged = true;
+// Set by a left click, the render loop picks the object under the cursor
+bool pickRequested = false;
+// Set when the cursor moved, the render loop reads the ID of the object under it with --hover
+bool cursorMoved = false;
+
+// Seconds the render loop sleeps between checks when nothing needs drawing. Input, window and shader file
+// events wake it at once, so these only bound how late a texture that finished decoding is shown.
+const double IDLE_TIMEOUT = 0.5;
+const double BUSY_TIMEOUT = 1.0 / 60.0; // while textures are decoding or a held key cannot move the camera
+
+// Scenes with at least this many objects are culled through the BVH, smaller ones with the flat SIMD test,
+// which is faster when there is little to skip
+const size_t BVH_CULL_THRESHOLD = 256;
+
+// Resolution of the CPU occlusion buffer, the window's aspect ratio at a fraction of its size
+const GLint OCCLUSION_WIDTH = 128, OCCLUSION_HEIGHT = OCCLUSION_WIDTH * HEIGHT / WIDTH;
+
+// Camera speeds per second, the old per-frame steps at 60 Hz
+const GLfloat CAMERA_SPEED = 0.6f;                // up/down and forward/backward
+const GLfloat STRAFE_SPEED = CAMERA_SPEED * 0.5f; // left/right speed is half
+const GLfloat TURN_SPEED   = 15.0f;               // degrees
+
+// Camera keys held during one frame as -1, 0 or 1 per axis, sampled once per frame and applied to
+// every simulation step of that frame
+struct CameraInput
+{
+    GLfloat Up, Forward, Right;
+    GLfloat Yaw, Pitch;
+};
 
-float screenToNDC_X(float x) { return (2.0f * x / WIDTH) - 1.0f; }
-float screenToNDC_Y(float y) { return 1.0f - (2.0f * y / HEIGHT); }
+GLfloat keyAxis(GLFWwindow* window, int positive, int negative)
+{
+    return (glfwGetKey(window, positive) == GLFW_PRESS ? 1.0f : 0.0f) -
+           (glfwGetKey(window, negative) == GLFW_PRESS ? 1.0f : 0.0f);
+}
 
-<<<<<<< HEAD
-//Creat Verticies function
-std::vector<GLfloat> createPrismVertices(const std::vector<std::pair<int,int>>& corners, float zFront, float zBack)
-=======
-std::vector<GLfloat> createPrismVertices(const std::vector<std::pair<int,int>>& corners, float zFront, float zBack, bool withTexCoords = false)
->>>>>>> feature_branch
+CameraInput sampleCameraInput(GLFWwindow* window)
 {
-    if(corners.size() != 4)
-    {
-        std::cerr << "Error: corners must have exactly 4 points." << std::endl;
-        return {};
-    }
+    CameraInput input;
+    input.Up      = keyAxis(window, GLFW_KEY_W, GLFW_KEY_S);       // Position controls (WASD, Q/E)
+    input.Forward = keyAxis(window, GLFW_KEY_Q, GLFW_KEY_E);
+    input.Right   = keyAxis(window, GLFW_KEY_D, GLFW_KEY_A);
+    input.Yaw     = keyAxis(window, GLFW_KEY_RIGHT, GLFW_KEY_LEFT); // Rotation controls (Arrow Keys)
+    input.Pitch   = keyAxis(window, GLFW_KEY_UP, GLFW_KEY_DOWN);
+    return input;
+}
 
-    float x0 = screenToNDC_X(corners[0].first);
-    float y0 = screenToNDC_Y(corners[0].second);
-    float x1 = screenToNDC_X(corners[1].first);
-    float y1 = screenToNDC_Y(corners[1].second);
-    float x2 = screenToNDC_X(corners[2].first);
-    float y2 = screenToNDC_Y(corners[2].second);
-    float x3 = screenToNDC_X(corners[3].first);
-    float y3 = screenToNDC_Y(corners[3].second);
+// Moves the camera by one simulation step of dt seconds. Its vectors are only recalculated while it turns.
+void stepCamera(const CameraInput& input, GLfloat dt)
+{
+    glm::vec3 position = camera.Position;
+    position += camera.WorldUp * (input.Up * CAMERA_SPEED * dt);
+    position += camera.Front * (input.Forward * CAMERA_SPEED * dt);
+    position += camera.Right * (input.Right * STRAFE_SPEED * dt);
 
-    if (withTexCoords) {
-        // With texture coordinates (5 components per vertex: x, y, z, s, t)
-        return {
-            // Front face
-            x0, y0, zFront,  0.0f, 0.0f,
-            x1, y1, zFront,  1.0f, 0.0f,
-            x2, y2, zFront,  1.0f, 1.0f,
-            x2, y2, zFront,  1.0f, 1.0f,
-            x3, y3, zFront,  0.0f, 1.0f,
-            x0, y0, zFront,  0.0f, 0.0f,
-
-            // Back face
-            x1, y1, zBack,   1.0f, 0.0f,
-            x0, y0, zBack,   0.0f, 0.0f,
-            x3, y3, zBack,   0.0f, 1.0f,
-            x3, y3, zBack,   0.0f, 1.0f,
-            x2, y2, zBack,   1.0f, 1.0f,
-            x1, y1, zBack,   1.0f, 0.0f,
-
-            // Left face
-            x0, y0, zBack,   1.0f, 0.0f,
-            x0, y0, zFront,  1.0f, 1.0f,
-            x3, y3, zFront,  0.0f, 1.0f,
-            x3, y3, zFront,  0.0f, 1.0f,
-            x3, y3, zBack,   0.0f, 0.0f,
-            x0, y0, zBack,   1.0f, 0.0f,
-
-            // Right face
-            x1, y1, zFront,  1.0f, 1.0f,
-            x1, y1, zBack,   1.0f, 0.0f,
-            x2, y2, zBack,   0.0f, 0.0f,
-            x2, y2, zBack,   0.0f, 0.0f,
-            x2, y2, zFront,  0.0f, 1.0f,
-            x1, y1, zFront,  1.0f, 1.0f,
-
-            // Top face (corrected)
-            x0, y0, zFront,  0.0f, 0.0f,  // bottom-left
-            x1, y1, zFront,  1.0f, 0.0f,  // bottom-right
-            x2, y2, zFront,  1.0f, 1.0f,  // top-right
-            x0, y0, zFront,  0.0f, 0.0f,  // bottom-left
-            x2, y2, zFront,  1.0f, 1.0f,  // top-right
-            x3, y3, zFront,  0.0f, 1.0f,  // top-left
-
-            // Bottom face
-            x0, y0, zBack,   0.0f, 0.0f,
-            x1, y1, zBack,   1.0f, 0.0f,
-            x3, y3, zBack,   0.0f, 1.0f,
-            x3, y3, zBack,   0.0f, 1.0f,
-            x1, y1, zBack,   1.0f, 0.0f,
-            x2, y2, zBack,   1.0f, 1.0f
-        };
-    } else {
-        // Without texture coordinates (3 components per vertex: x, y, z)
-        return {
-            x0, y0, zFront,  x1, y1, zFront,  x2, y2, zFront,
-            x2, y2, zFront,  x3, y3, zFront,  x0, y0, zFront,
+    // Clamp vertical movement
+    position.y = glm::clamp(position.y, -5.0f, 5.0f);
+
+    // Constrain pitch to avoid flipping
+    GLfloat pitch = glm::clamp(camera.Pitch + input.Pitch * TURN_SPEED * dt, -89.0f, 89.0f);
 
-            x0, y0, zBack,   x1, y1, zBack,   x2, y2, zBack,
-            x2, y2, zBack,   x3, y3, zBack,   x0, y0, zBack,
+    camera.SetPose(position, camera.Yaw + input.Yaw * TURN_SPEED * dt, pitch);
+}
 
-            x0, y0, zFront,  x0, y0, zBack,   x3, y3, zBack,
-            x3, y3, zBack,   x3, y3, zFront,  x0, y0, zFront,
+// a + (b - a) * t, which is exactly a when a == b. glm::mix computes a * (1 - t) + b * t, which can be an ulp
+// off and would make a camera that stands still look moved.
+template <typename T>
+T lerp(const T& a, const T& b, GLfloat t)
+{
+    return a + (b - a) * t;
+}
 
-            x1, y1, zFront,  x1, y1, zBack,   x2, y2, zBack,
-            x2, y2, zBack,   x2, y2, zFront,  x1, y1, zFront,
+float screenToNDC_X(float x) { return (2.0f * x / WIDTH) - 1.0f; }
+float screenToNDC_Y(float y) { return 1.0f - (2.0f * y / HEIGHT); }
 
-            x0, y0, zFront,  x1, y1, zFront,  x1, y1, zBack,
-            x1, y1, zBack,   x0, y0, zBack,   x0, y0, zFront,
+// Vertex and index counts of every primitive, so the geometry of a whole scene can be sized before it is built
+constexpr GLsizei PRISM_VERTEX_COUNT = 8;           // shared corners of a solid colour prism
+constexpr GLsizei TEXTURED_PRISM_VERTEX_COUNT = 24; // 4 per face, each with its own texture coordinates
+constexpr GLsizei PRISM_INDEX_COUNT = 36;           // 6 faces of 2 triangles
+constexpr GLsizei circleVertexCount(GLint segments) { return segments * 3; } // one triangle per segment
+
+//Creat Verticies function (corners are the 4 pixel-space corners of the front face)
+// Writes an indexed prism: PRISM_VERTEX_COUNT shared corners (x, y, z) for solid colour prisms, or
+// TEXTURED_PRISM_VERTEX_COUNT vertices (x, y, z, s, t) when withTexCoords is set so every face gets its own
+// texture coordinates. indices receives PRISM_INDEX_COUNT indices.
+void createPrismVertices(const glm::vec2* corners, float zFront, float zBack, bool withTexCoords,
+                         GLfloat* vertices, GLushort* indices)
+{
+    float x[4], y[4];
+    for (int i = 0; i < 4; ++i) {
+        x[i] = screenToNDC_X(corners[i].x);
+        y[i] = screenToNDC_Y(corners[i].y);
+    }
 
-            x3, y3, zFront,  x2, y2, zFront,  x2, y2, zBack,
-            x2, y2, zBack,   x3, y3, zBack,   x3, y3, zFront
+    if (withTexCoords) {
+        // Corner and texture coordinate of the 4 vertices of every face
+        static const int faceCorners[6][4] = {
+            {0, 1, 2, 3}, // Front face
+            {0, 1, 2, 3}, // Back face
+            {0, 0, 3, 3}, // Left face
+            {1, 1, 2, 2}, // Right face
+            {0, 1, 1, 0}, // Top face
+            {3, 2, 2, 3}  // Bottom face
+        };
+        static const bool faceFront[6][4] = {
+            {true,  true,  true,  true},
+            {false, false, false, false},
+            {false, true,  true,  false},
+            {true,  false, false, true},
+            {true,  true,  false, false},
+            {true,  true,  false, false}
+        };
+        static const float faceUVs[6][4][2] = {
+            {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}},
+            {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}},
+            {{1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}, {0.0f, 0.0f}},
+            {{1.0f, 1.0f}, {1.0f, 0.0f}, {0.0f, 0.0f}, {0.0f, 1.0f}},
+            {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}},
+            {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}}
         };
+        for (int f = 0; f < 6; ++f) {
+            for (int v = 0; v < 4; ++v) {
+                GLfloat* out = &vertices[(f * 4 + v) * 5];
+                int c = faceCorners[f][v];
+                out[0] = x[c];
+                out[1] = y[c];
+                out[2] = faceFront[f][v] ? zFront : zBack;
+                out[3] = faceUVs[f][v][0];
+                out[4] = faceUVs[f][v][1];
+            }
+            GLushort base = (GLushort)(f * 4);
+            GLushort* quad = &indices[f * 6];
+            quad[0] = base;     quad[1] = base + 1; quad[2] = base + 2;
+            quad[3] = base + 2; quad[4] = base + 3; quad[5] = base;
+        }
+    } else {
+        // Front corners are 0-3, back corners 4-7
+        static const GLushort prismIndices[PRISM_INDEX_COUNT] = {
+            0, 1, 2,  2, 3, 0, // Front face
+            4, 5, 6,  6, 7, 4, // Back face
+            0, 4, 7,  7, 3, 0, // Left face
+            1, 5, 6,  6, 2, 1, // Right face
+            0, 1, 5,  5, 4, 0, // Top face
+            3, 2, 6,  6, 7, 3  // Bottom face
+        };
+        for (int c = 0; c < 4; ++c) {
+            GLfloat* front = &vertices[c * 3];
+            GLfloat* back = &vertices[(c + 4) * 3];
+            front[0] = back[0] = x[c];
+            front[1] = back[1] = y[c];
+            front[2] = zFront;
+            back[2] = zBack;
+        }
+        std::copy(prismIndices, prismIndices + PRISM_INDEX_COUNT, indices);
     }
 }
 
-// Helper to convert 0-255 RGB to glm::vec4 (RGBA)
-glm::vec4 rgb255(int r, int g, int b, int a = 255) {
-    return glm::vec4(r / 255.0f, g / 255.0f, b / 255.0f, a / 255.0f);
-}
-
-
 // Create circle verticies function
-std::vector<GLfloat> createCircleVertices(float centerX, float centerY, float z, float radius, int segments = 32)
+// Writes circleVertexCount(segments) vertices (x, y, z), a fan of separate triangles around the centre
+void createCircleVertices(float centerX, float centerY, float z, float radius, int segments, GLfloat* vertices)
 {
-    std::vector<GLfloat> vertices;
+    const float ndcCenterX = screenToNDC_X(centerX);
+    const float ndcCenterY = screenToNDC_Y(centerY);
     for(int i = 0; i < segments; ++i)
     {
         float theta1 = 2.0f * 3.1415926f * float(i) / float(segments);
@@ -167,1075 +244,754 @@ std::vector<GLfloat> createCircleVertices(float centerX, float centerY, float z,
         float x2 = centerX + radius * cos(theta2);
         float y2 = centerY + radius * sin(theta2);
 
-        vertices.push_back(screenToNDC_X(centerX)); // Triangle center
-        vertices.push_back(screenToNDC_Y(centerY));
-        vertices.push_back(z);
+        GLfloat* out = &vertices[i * 9];
+        out[0] = ndcCenterX; // Triangle center
+        out[1] = ndcCenterY;
+        out[2] = z;
+
+        out[3] = screenToNDC_X(x1); // Edge point 1
+        out[4] = screenToNDC_Y(y1);
+        out[5] = z;
+
+        out[6] = screenToNDC_X(x2); // Edge point 2
+        out[7] = screenToNDC_Y(y2);
+        out[8] = z;
+    }
+}
+
+// Geometry of one scene object in memory owned by the caller. Indices is null for primitives drawn in order.
+struct ObjectGeometry
+{
+    GLenum Mode;
+    GLint FloatsPerVertex; // 5 for textured prisms, 3 otherwise
+    GLsizei VertexCount;
+    GLsizei IndexCount;
+    GLfloat* Vertices;
+    GLushort* Indices;
+};
+
+// Mode and sizes of an object's geometry, without building it (the pointers stay null)
+ObjectGeometry measureObject(const SceneObject& object)
+{
+    ObjectGeometry geometry = { GL_TRIANGLES, 3, 0, 0, nullptr, nullptr };
+    switch (object.Kind)
+    {
+    case PRIM_WALL:
+        // The wall is the clear colour, it has no geometry
+        break;
+    case PRIM_PRISM:
+        if (object.Texture >= 0) {
+            geometry.FloatsPerVertex = 5;
+            geometry.VertexCount = TEXTURED_PRISM_VERTEX_COUNT;
+        } else {
+            geometry.VertexCount = PRISM_VERTEX_COUNT;
+        }
+        geometry.IndexCount = PRISM_INDEX_COUNT;
+        break;
+    case PRIM_CIRCLE:
+        geometry.VertexCount = circleVertexCount(object.Segments);
+        break;
+    case PRIM_LINES:
+        geometry.Mode = GL_LINES;
+        geometry.VertexCount = object.PointCount;
+        break;
+    }
+    return geometry;
+}
 
-        vertices.push_back(screenToNDC_X(x1)); // Edge point 1
-        vertices.push_back(screenToNDC_Y(y1));
-        vertices.push_back(z);
+// Bytes of arena measureObject's sizes take, sum them over a scene to size the arena it is built in
+size_t objectFootprint(const ObjectGeometry& geometry)
+{
+    return LinearArena::Footprint<GLfloat>((size_t)geometry.VertexCount * geometry.FloatsPerVertex) +
+           LinearArena::Footprint<GLushort>(geometry.IndexCount);
+}
 
-        vertices.push_back(screenToNDC_X(x2)); // Edge point 2
-        vertices.push_back(screenToNDC_Y(y2));
-        vertices.push_back(z);
+// Builds the geometry of one scene object into arena, which must have room for its objectFootprint()
+ObjectGeometry createObjectGeometry(const SceneObject& object, LinearArena& arena)
+{
+    ObjectGeometry geometry = measureObject(object);
+    geometry.Vertices = arena.Allocate<GLfloat>((size_t)geometry.VertexCount * geometry.FloatsPerVertex);
+    if (geometry.IndexCount > 0)
+        geometry.Indices = arena.Allocate<GLushort>(geometry.IndexCount);
+    switch (object.Kind)
+    {
+    case PRIM_WALL:
+        break;
+    case PRIM_PRISM:
+        createPrismVertices(object.Points, object.ZFront, object.ZBack, object.Texture >= 0, geometry.Vertices, geometry.Indices);
+        break;
+    case PRIM_CIRCLE:
+        createCircleVertices(object.Points[0].x, object.Points[0].y, object.ZFront, object.Radius, object.Segments, geometry.Vertices);
+        break;
+    case PRIM_LINES:
+        for (GLint i = 0; i < object.PointCount; ++i)
+        {
+            geometry.Vertices[i * 3] = screenToNDC_X(object.Points[i].x);
+            geometry.Vertices[i * 3 + 1] = screenToNDC_Y(object.Points[i].y);
+            geometry.Vertices[i * 3 + 2] = object.ZFront;
+        }
+        break;
     }
-    return vertices;
+    return geometry;
 }
 
 // main
-int main()
+int main(int argc, char** argv)
 {
+    // Command line: [--classic] [--headless] [--bench] [--profile] [--lit] [--continuous] [--occlusion] [--hover] [--frames N] [--output DIR] [scene file]
+    const char* scenePath = "scene.txt";
+    bool forceClassic = false;   // draw object by object even when batching is available
+    bool headless = false;       // render offscreen along the camera path and dump the frames
+    bool bench = false;          // time a fixed number of frames along the camera path
+    bool profile = false;        // time every render pass on the GPU
+    bool lit = false;            // shade objects with a directional light
+    bool continuous = false;     // redraw every frame instead of only when something changed
+    bool occlusion = false;      // skip objects hidden behind others
+    bool hover = false;          // highlight the object under the cursor through an object ID buffer
+    int pathFrames = 0;          // frames rendered along the camera path, 0 = mode default
+    std::string outputDir = "frames";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--classic")
+            forceClassic = true;
+        else if (arg == "--headless")
+            headless = true;
+        else if (arg == "--bench")
+            bench = true;
+        else if (arg == "--profile")
+            profile = true;
+        else if (arg == "--lit")
+            lit = true;
+        else if (arg == "--continuous")
+            continuous = true;
+        else if (arg == "--occlusion")
+            occlusion = true;
+        else if (arg == "--hover")
+            hover = true;
+        else if (arg == "--frames" && i + 1 < argc)
+            pathFrames = std::max(1, atoi(argv[++i]));
+        else if (arg == "--output" && i + 1 < argc)
+            outputDir = argv[++i];
+        else
+            scenePath = argv[i];
+    }
+    if (pathFrames == 0)
+        pathFrames = bench ? 1000 : 120;
+
+    // Without a display server a headless run has no window system to talk to,
+    // so use GLFW's null platform with an OSMesa (software) context instead
+    bool noDisplay = !getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY");
+#ifdef GLFW_PLATFORM_NULL
+    if (headless && noDisplay)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
 
     // initialize glf window 
+    TRACE_BEGIN("window");
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,3);
     glfwWindowHint(GLFW_OPENGL_PROFILE,GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    if (headless) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef GLFW_OSMESA_CONTEXT_API
+        if (noDisplay)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+    }
 
-    GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "Prisms", nullptr, nullptr);
+    // Try a 4.3 context for the batched renderer first, fall back to 3.3
+    GLFWwindow* window = nullptr;
+    const int contextVersions[2][2] = { {4, 3}, {3, 3} };
+    for (int i = 0; i < 2 && !window; ++i) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, contextVersions[i][0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, contextVersions[i][1]);
+        window = glfwCreateWindow(WIDTH, HEIGHT, "Prisms", nullptr, nullptr);
+    }
     if(!window){ std::cout<<"Failed to create window\n"; glfwTerminate(); return -1; }
     glfwMakeContextCurrent(window);
     glfwSetKeyCallback(window,key_callback);
     glfwSetScrollCallback(window,scroll_callback);
+    glfwSetWindowRefreshCallback(window,refresh_callback);
+    glfwSetMouseButtonCallback(window,mouse_button_callback);
+    glfwSetCursorPosCallback(window,cursor_pos_callback);
+    TRACE_END("window");
 
+    TRACE_BEGIN("glewInit");
     glewExperimental = GL_TRUE;
     if(glewInit()!=GLEW_OK){ std::cout<<"Failed to initialize GLEW\n"; return -1; }
+    TRACE_END("glewInit");
 
     glViewport(0,0,WIDTH,HEIGHT);
     glEnable(GL_DEPTH_TEST);
      
-    // Include shader files
-    Shader shader("basic.vs","basic.frag");
+    // Include shader files, compiled once per feature set the scene needs
+    TRACE_BEGIN("shaders");
+    ShaderPermutations shaders("basic.vs","basic.frag");
+    // Camera matrices come from one uniform buffer shared by every program
+    shaders.OnCompile = [](Shader& variant) {
+        variant.BindUniformBlock("FrameData", FrameUniforms::BINDING);
+        variant.Use();
+        variant.SetInt(variant.Uniform(UniformHash("ourTexture")), 0);
+        variant.SetMat4(variant.Uniform(UniformHash("model")), glm::mat4(1.0f));
+    };
+    // With --hover every variant also writes object IDs, lines have no faces to light
+    const GLuint lineFeatures = hover ? SHADER_OBJECT_ID : 0;
+    const GLuint litFeature = (lit ? SHADER_LIT : 0) | lineFeatures;
+
+    FrameUniforms frameUniforms;
+    frameUniforms.Create();
+    TRACE_END("shaders");
 
     //--------------------------------------------------------
     // Creation of objects
     //--------------------------------------------------------
-
-    // --- Glasses Case (on top of Bible) ---
-    std::vector<std::pair<int,int>> corners1 = {
-    {400, 528}, {480, 528}, {480, 560}, {400, 560}
-    };
-
-    glm::vec4 color1 = rgb255(105,105,107); // gray
-    std::vector<GLfloat> vertices1 = createPrismVertices(corners1,-0.5f,-0.6f);
-
-    GLuint VAO1,VBO1;
-    glGenVertexArrays(1,&VAO1);
-    glGenBuffers(1,&VBO1);
-    glBindVertexArray(VAO1);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO1);
-    glBufferData(GL_ARRAY_BUFFER,vertices1.size()*sizeof(GLfloat),vertices1.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- Bible ---
-    std::vector<std::pair<int,int>> corners2 = {
-    {380, 560}, {505, 560}, {505, 582}, {380, 582}
-    };
-
-    glm::vec4 color2 = rgb255(150,153,149);// light gray
-    std::vector<GLfloat> vertices2 = createPrismVertices(corners2,-0.5f,-0.8f);
-
-    GLuint VAO2,VBO2;
-    glGenVertexArrays(1,&VAO2);
-    glGenBuffers(1,&VBO2);
-    glBindVertexArray(VAO2);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO2);
-    glBufferData(GL_ARRAY_BUFFER,vertices2.size()*sizeof(GLfloat),vertices2.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-
-    // --- Wall ---
-    glm::vec4 color3 = rgb255(233, 227, 213); // cream
-    std::vector<GLfloat> vertices3 = {
-        -1.0f, -1.0f, 0.0f,  // bottom-left
-        1.0f, -1.0f, 0.0f,   // bottom-right
-        1.0f,  1.0f, 0.0f,   // top-right
-
-        1.0f,  1.0f, 0.0f,   // top-right
-        -1.0f,  1.0f, 0.0f,  // top-left
-        -1.0f, -1.0f, 0.0f   // bottom-left
-    };
-
-    GLuint VAO3, VBO3;
-    glGenVertexArrays(1, &VAO3);
-    glGenBuffers(1, &VBO3);
-    glBindVertexArray(VAO3);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO3);
-    glBufferData(GL_ARRAY_BUFFER, vertices3.size() * sizeof(GLfloat), vertices3.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- DVD Player Pt1 ---
-    std::vector<std::pair<int,int>> corners4 = {
-    {356, 662}, {454, 662}, {454, 695}, {356, 695}
-    };
-
-
-    glm::vec4 color4 = rgb255(43, 43, 41); // light gray
-    std::vector<GLfloat> vertices4 = createPrismVertices(corners4,-0.6f,-1.0f);
-
-    GLuint VAO4,VBO4;
-    glGenVertexArrays(1,&VAO4);
-    glGenBuffers(1,&VBO4);
-    glBindVertexArray(VAO4);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO4);
-    glBufferData(GL_ARRAY_BUFFER,vertices4.size()*sizeof(GLfloat),vertices4.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- DVD Player Pt2 (flush with Pt1) ---
-    std::vector<std::pair<int,int>> corners5 = {
-        {454, 662}, {487, 662}, {487, 695}, {454, 695}
-    };
-
-    glm::vec4 color5 = rgb255(10, 10, 10); // near black
-    std::vector<GLfloat> vertices5 = createPrismVertices(corners5,-0.6f,-1.0f);
-
-    GLuint VAO5,VBO5;
-    glGenVertexArrays(1,&VAO5);
-    glGenBuffers(1,&VBO5);
-    glBindVertexArray(VAO5);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO5);
-    glBufferData(GL_ARRAY_BUFFER,vertices5.size()*sizeof(GLfloat),vertices5.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // Cabinet Top ---
-    std::vector<std::pair<int,int>> corners6 = {
-    {0, 582}, {702, 582}, {702, 594}, {0, 594}
-    };
-
-    glm::vec4 color6 = rgb255(70, 46, 29); // brown (will add texture)
-    std::vector<GLfloat> vertices6 = createPrismVertices(corners6,-0.5f,-1.0f);
-
-    GLuint VAO6,VBO6;
-    glGenVertexArrays(1,&VAO6);
-    glGenBuffers(1,&VBO6);
-    glBindVertexArray(VAO6);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO6);
-    glBufferData(GL_ARRAY_BUFFER,vertices6.size()*sizeof(GLfloat),vertices6.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // Cabinet Base ---
-    std::vector<std::pair<int,int>> corners7 = {
-        {0, 880}, {702,880}, {702,906}, {0,906}
-    };
-    glm::vec4 color7 = rgb255(27, 26, 24); // black base
-    std::vector<GLfloat> vertices7 = createPrismVertices(corners7,-0.5f,-1.0f);
-
-    GLuint VAO7,VBO7;
-    glGenVertexArrays(1,&VAO7);
-    glGenBuffers(1,&VBO7);
-    glBindVertexArray(VAO7);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO7);
-    glBufferData(GL_ARRAY_BUFFER,vertices7.size()*sizeof(GLfloat),vertices7.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // Cabinet Base Support 1 ---
-    std::vector<std::pair<int,int>> corners8 = {
-    {201, 594}, {215, 594}, {215, 880}, {201, 880}
-    };
-
-    glm::vec4 color8 = rgb255(27, 26, 24); // black base
-    std::vector<GLfloat> vertices8 = createPrismVertices(corners8,-0.47f,-1.0f);
-
-    GLuint VAO8,VBO8;
-    glGenVertexArrays(1,&VAO8);
-    glGenBuffers(1,&VBO8);
-    glBindVertexArray(VAO8);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO8);
-    glBufferData(GL_ARRAY_BUFFER,vertices8.size()*sizeof(GLfloat),vertices8.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // Cabinet Base Support 2 (mirrored on right side)
-    std::vector<std::pair<int,int>> corners9 = {
-        {487, 594}, {501, 594}, {501, 880}, {487, 880}
-    };
-
-    glm::vec4 color9 = rgb255(27, 26, 24); // same black base
-    std::vector<GLfloat> vertices9 = createPrismVertices(corners9,-0.47f,-1.0f);
-
-    GLuint VAO9,VBO9;
-    glGenVertexArrays(1,&VAO9);
-    glGenBuffers(1,&VBO9);
-    glBindVertexArray(VAO9);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO9);
-    glBufferData(GL_ARRAY_BUFFER,vertices9.size()*sizeof(GLfloat),vertices9.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // Cabinet Back
-    std::vector<std::pair<int,int>> corners10 = {
-        {0, 594}, {702, 594}, {702, 906}, {0, 906}
-    };
-
-    glm::vec4 color10 = rgb255(6, 6, 6); // same black base
-    std::vector<GLfloat> vertices10 = createPrismVertices(corners10,-0.9f,-1.1f);
-
-    GLuint VAO10,VBO10;
-    glGenVertexArrays(1,&VAO10);
-    glGenBuffers(1,&VBO10);
-    glBindVertexArray(VAO10);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO10);
-    glBufferData(GL_ARRAY_BUFFER,vertices10.size()*sizeof(GLfloat),vertices10.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- Shelf under DVD player ---
-    std::vector<std::pair<int,int>> corners11 = {
-        {201, 695}, {501, 695}, {501, 705}, {201, 705}
-    };
-
-    glm::vec4 color11 = rgb255(21, 18, 18); // dark shelf
-    std::vector<GLfloat> vertices11 = createPrismVertices(corners11, -0.5f, -1.0f);
-
-    GLuint VAO11, VBO11;
-    glGenVertexArrays(1, &VAO11);
-    glGenBuffers(1, &VBO11);
-    glBindVertexArray(VAO11);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO11);
-    glBufferData(GL_ARRAY_BUFFER, vertices11.size() * sizeof(GLfloat), vertices11.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- TV ---
-    std::vector<std::pair<int,int>> corners12 = {
-        {143,180}, {625,180}, {625,554}, {143,554}
-    };
-
-    glm::vec4 color12 = rgb255(21, 18, 18); // TV Screen 
-    std::vector<GLfloat> vertices12 = createPrismVertices(corners12, -0.9f, -1.0f);
-
-    GLuint VAO12, VBO12;
-    glGenVertexArrays(1, &VAO12);
-    glGenBuffers(1, &VBO12);
-    glBindVertexArray(VAO12);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO12);
-    glBufferData(GL_ARRAY_BUFFER, vertices12.size() * sizeof(GLfloat), vertices12.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- TV boarder ---
-    std::vector<std::pair<int,int>> corners13 = {
-        {143,554}, {625,554}, {625,544}, {143,544}
-    };
-
-    glm::vec4 color13 = rgb255(41, 40, 38); // TV Boarder
-    std::vector<GLfloat> vertices13 = createPrismVertices(corners13, -0.88, -0.9f);
-
-    GLuint VAO13, VBO13;
-    glGenVertexArrays(1, &VAO13);
-    glGenBuffers(1, &VBO13);
-    glBindVertexArray(VAO13);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO13);
-    glBufferData(GL_ARRAY_BUFFER, vertices13.size() * sizeof(GLfloat), vertices13.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- Switch case ---
-    std::vector<std::pair<int,int>> corners14 = {
-        {11,518}, {171,518}, {171,582}, {11,582}
-    };
-
-    glm::vec4 color14 = rgb255(125, 122, 113); // Switch Case
-    std::vector<GLfloat> vertices14 = createPrismVertices(corners14, -0.6, -0.8f);
-
-    GLuint VAO14, VBO14;
-    glGenVertexArrays(1, &VAO14);
-    glGenBuffers(1, &VBO14);
-    glBindVertexArray(VAO14);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO14);
-    glBufferData(GL_ARRAY_BUFFER, vertices14.size() * sizeof(GLfloat), vertices14.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- Switch case zipper ---
-    std::vector<std::pair<int,int>> corners15 = {
-        {7,545}, {175,545}, {175,559}, {7,559}
-    };
-
-    glm::vec4 color15 = rgb255(39, 35, 34); // Zipper Color
-    std::vector<GLfloat> vertices15 = createPrismVertices(corners15, -0.59, -0.81f);
-
-    GLuint VAO15, VBO15;
-    glGenVertexArrays(1, &VAO15);
-    glGenBuffers(1, &VBO15);
-    glBindVertexArray(VAO15);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO15);
-    glBufferData(GL_ARRAY_BUFFER, vertices15.size() * sizeof(GLfloat), vertices15.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- Waterbottle ---
-    std::vector<std::pair<int,int>> corners16 = {
-        {67,451}, {113,451}, {113,582}, {67,582}
-    };
-
-    glm::vec4 color16 = rgb255(80, 52, 125); // Purple
-    std::vector<GLfloat> vertices16 = createPrismVertices(corners16, -0.8, -0.9f);
-
-    GLuint VAO16, VBO16;
-    glGenVertexArrays(1, &VAO16);
-    glGenBuffers(1, &VBO16);
-    glBindVertexArray(VAO16);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO16);
-    glBufferData(GL_ARRAY_BUFFER, vertices16.size() * sizeof(GLfloat), vertices16.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- Waterbottle neck ---
-    std::vector<std::pair<int,int>> corners17 = {
-        {72,431}, {108,431}, {108,451}, {72,451}
-    };
-
-    glm::vec4 color17 = rgb255(80, 52, 125); // Purple
-    std::vector<GLfloat> vertices17 = createPrismVertices(corners17, -0.8, -0.9f);
-
-    GLuint VAO17, VBO17;
-    glGenVertexArrays(1, &VAO17);
-    glGenBuffers(1, &VBO17);
-    glBindVertexArray(VAO17);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO17);
-    glBufferData(GL_ARRAY_BUFFER, vertices17.size() * sizeof(GLfloat), vertices17.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- Waterbottle silver ring ---
-    std::vector<std::pair<int,int>> corners18 = {
-        {72,426}, {108,426}, {108,431}, {72,431}
-    };
-
-    glm::vec4 color18 = rgb255(135, 127, 133); // silver
-    std::vector<GLfloat> vertices18 = createPrismVertices(corners18, -0.8, -0.9f);
-
-    GLuint VAO18, VBO18;
-    glGenVertexArrays(1, &VAO18);
-    glGenBuffers(1, &VBO18);
-    glBindVertexArray(VAO18);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO18);
-    glBufferData(GL_ARRAY_BUFFER, vertices18.size() * sizeof(GLfloat), vertices18.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- Waterbottle Lid ---
-    std::vector<std::pair<int,int>> corners19 = {
-        {72,396}, {108,396}, {108,426}, {72,426}
-    };
-
-    glm::vec4 color19 = rgb255(30, 27, 28); // black
-    std::vector<GLfloat> vertices19 = createPrismVertices(corners19, -0.8, -0.9f);
-
-    GLuint VAO19, VBO19;
-    glGenVertexArrays(1, &VAO19);
-    glGenBuffers(1, &VBO19);
-    glBindVertexArray(VAO19);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO19);
-    glBufferData(GL_ARRAY_BUFFER, vertices19.size() * sizeof(GLfloat), vertices19.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // Cabinet Base Support 3 ---
-    std::vector<std::pair<int,int>> corners20 = {
-    {0, 594}, {14, 594}, {14, 880}, {0, 880}
-    };
-
-    glm::vec4 color20 = rgb255(27, 26, 24); // black base
-    std::vector<GLfloat> vertices20 = createPrismVertices(corners20,-0.5f,-1.0f);
-
-    GLuint VAO20,VBO20;
-    glGenVertexArrays(1,&VAO20);
-    glGenBuffers(1,&VBO20);
-    glBindVertexArray(VAO20);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO20);
-    glBufferData(GL_ARRAY_BUFFER,vertices20.size()*sizeof(GLfloat),vertices20.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // Cabinet Base Support 4 ---
-    std::vector<std::pair<int,int>> corners21 = {
-    {688, 594}, {702, 594}, {702, 880}, {688, 880}
-    };
-
-    glm::vec4 color21 = rgb255(27, 26, 24); // black base
-    std::vector<GLfloat> vertices21 = createPrismVertices(corners21,-0.5f,-1.0f);
-
-    GLuint VAO21,VBO21;
-    glGenVertexArrays(1,&VAO21);
-    glGenBuffers(1,&VBO21);
-    glBindVertexArray(VAO21);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO21);
-    glBufferData(GL_ARRAY_BUFFER,vertices21.size()*sizeof(GLfloat),vertices21.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // switch dock ---
-    std::vector<std::pair<int,int>> corners22 = {
-    {562, 529}, {658, 529}, {658, 582}, {562, 582}
-    };
-
-    glm::vec4 color22 = rgb255(227, 224, 215); // white
-    std::vector<GLfloat> vertices22 = createPrismVertices(corners22,-0.5f,-0.7f);
-
-    GLuint VAO22,VBO22;
-    glGenVertexArrays(1,&VAO22);
-    glGenBuffers(1,&VBO22);
-    glBindVertexArray(VAO22);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO22);
-    glBufferData(GL_ARRAY_BUFFER,vertices22.size()*sizeof(GLfloat),vertices22.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // switch ---
-    std::vector<std::pair<int,int>> corners23 = {
-    {562, 514}, {658, 514}, {658, 572}, {562, 572}
-    };
-
-    glm::vec4 color23 = rgb255(33, 33, 33); // black
-    std::vector<GLfloat> vertices23 = createPrismVertices(corners23,-0.55f,-0.65f);
-
-    GLuint VAO23,VBO23;
-    glGenVertexArrays(1,&VAO23);
-    glGenBuffers(1,&VBO23);
-    glBindVertexArray(VAO23);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO23);
-    glBufferData(GL_ARRAY_BUFFER,vertices23.size()*sizeof(GLfloat),vertices23.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // Joy Con L ---
-    std::vector<std::pair<int,int>> corners24 = {
-    {547, 514}, {562, 514}, {562, 572}, {547, 572}
-    };
-
-    glm::vec4 color24 = rgb255(253, 58, 65); // red
-    std::vector<GLfloat> vertices24 = createPrismVertices(corners24,-0.55f,-0.65f);
-
-    GLuint VAO24,VBO24;
-    glGenVertexArrays(1,&VAO24);
-    glGenBuffers(1,&VBO24);
-    glBindVertexArray(VAO24);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO24);
-    glBufferData(GL_ARRAY_BUFFER,vertices24.size()*sizeof(GLfloat),vertices24.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // Joy Con R ---
-    std::vector<std::pair<int,int>> corners25 = {
-    {658, 514}, {673, 514}, {673, 572}, {658, 572}
-    };
-
-    glm::vec4 color25 = rgb255(4, 135, 183); // blue
-    std::vector<GLfloat> vertices25 = createPrismVertices(corners25,-0.55f,-0.65f);
-
-    GLuint VAO25,VBO25;
-    glGenVertexArrays(1,&VAO25);
-    glGenBuffers(1,&VBO25);
-    glBindVertexArray(VAO25);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO25);
-    glBufferData(GL_ARRAY_BUFFER,vertices25.size()*sizeof(GLfloat),vertices25.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // tv leg 1 ---
-    std::vector<std::pair<int,int>> corners26 = {
-    {203, 544}, {215, 544}, {199, 582}, {193, 582},
-    };
-
-    glm::vec4 color26 = rgb255(33, 33, 33); // black
-    std::vector<GLfloat> vertices26 = createPrismVertices(corners26,-0.9f,-1.0f);
-
-    GLuint VAO26,VBO26;
-    glGenVertexArrays(1,&VAO26);
-    glGenBuffers(1,&VBO26);
-    glBindVertexArray(VAO26);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO26);
-    glBufferData(GL_ARRAY_BUFFER,vertices26.size()*sizeof(GLfloat),vertices26.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // tv leg 2 ---
-    std::vector<std::pair<int,int>> corners27 = {
-    {203, 544}, {215, 544}, {224, 582}, {219, 582}
-    };
-
-    glm::vec4 color27 = rgb255(33, 33, 33); // black
-    std::vector<GLfloat> vertices27 = createPrismVertices(corners27,-0.9f,-1.0f);
-
-    GLuint VAO27,VBO27;
-    glGenVertexArrays(1,&VAO27);
-    glGenBuffers(1,&VBO27);
-    glBindVertexArray(VAO27);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO27);
-    glBufferData(GL_ARRAY_BUFFER,vertices27.size()*sizeof(GLfloat),vertices27.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // tv leg 3 ---
-    std::vector<std::pair<int,int>> corners30 = {
-    {553, 544}, {565, 544}, {554, 582}, {549, 582},
-    };
-
-    glm::vec4 color30 = rgb255(33, 33, 33); // black
-    std::vector<GLfloat> vertices30 = createPrismVertices(corners30,-0.9f,-1.0f);
-
-    GLuint VAO30,VBO30;
-    glGenVertexArrays(1,&VAO30);
-    glGenBuffers(1,&VBO30);
-    glBindVertexArray(VAO30);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO30);
-    glBufferData(GL_ARRAY_BUFFER,vertices30.size()*sizeof(GLfloat),vertices30.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // tv leg 4 ---
-    std::vector<std::pair<int,int>> corners31 = {
-    {553, 544}, {565, 544}, {575, 582}, {569, 582}
-    };
-
-    glm::vec4 color31 = rgb255(33, 33, 33); // black
-    std::vector<GLfloat> vertices31 = createPrismVertices(corners31,-0.9f,-1.0f);
-
-    GLuint VAO31,VBO31;
-    glGenVertexArrays(1,&VAO31);
-    glGenBuffers(1,&VBO31);
-    glBindVertexArray(VAO31);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO31);
-    glBufferData(GL_ARRAY_BUFFER,vertices31.size()*sizeof(GLfloat),vertices31.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // Kleenex Box ---
-    std::vector<std::pair<int,int>> corners28 = {
-        {442, 788}, {486, 788}, {486, 880}, {442, 880}
-    };
-
-    glm::vec4 color28 = rgb255(240, 234, 235); // white
-    std::vector<GLfloat> vertices28 = createPrismVertices(corners28, -0.6f, -0.8f, true);  // true means include texture coords
-
-    // Load Kleenex box texture
-    GLuint kleenexTexture = loadTexture("kleenex-box.jpg");
-    if (kleenexTexture == 0) {
-        std::cerr << "Failed to load Kleenex box texture" << std::endl;
+    TRACE_BEGIN("scene");
+    Scene scene;
+    if (!scene.Load(scenePath)) {
+        glfwTerminate();
         return -1;
     }
-
-    GLuint VAO28, VBO28;
-    glGenVertexArrays(1, &VAO28);
-    glGenBuffers(1, &VBO28);
-    glBindVertexArray(VAO28);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO28);
-    glBufferData(GL_ARRAY_BUFFER, vertices28.size() * sizeof(GLfloat), vertices28.data(), GL_STATIC_DRAW);
-
-    // Position attribute (3 floats)
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Texture coordinate attribute (2 floats)
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-
-    glBindVertexArray(0);
-
-    // Carpet ---
-    std::vector<std::pair<int,int>> corners29 = {
-    {0, 906}, {702, 906}, {702, 908}, {0, 908}
+    TRACE_END("scene");
+
+    // Queue every texture the scene references once, texture i goes to layer i of one array texture.
+    // They are loaded on worker threads and show the colour of the first object using them until uploaded.
+    TRACE_BEGIN("textures");
+    TextureLoader textureLoader((GLsizei)scene.TexturePaths.size());
+    for (size_t t = 0; t < scene.TexturePaths.size(); ++t) {
+        glm::vec4 placeholder = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+        for (const SceneObject& object : scene.Objects) {
+            if (object.Texture == (GLint)t) {
+                placeholder = object.Color;
+                break;
+            }
+        }
+        textureLoader.Load(scene.TexturePaths[t], placeholder);
+    }
+    TRACE_END("textures");
+
+    // Every object goes through one multi-draw-indirect batch when the context supports it
+    bool useBatch = !forceClassic && BatchRenderer::Supported();
+    // Occlusion culling runs on the GPU against the previous frame's depth when batching, on the CPU otherwise
+    const bool gpuOcclusion = occlusion && useBatch && HiZCuller::Supported();
+    const bool cpuOcclusion = occlusion && !gpuOcclusion;
+
+    // Pack every object into one shared vertex/index buffer, and keep its bounding box for culling
+    TRACE_BEGIN("geometry");
+    GeometryPool geometry;
+    std::vector<DrawRange> ranges(scene.Objects.size());
+    BoundsArray bounds;
+    // Triangles of every solid object for mouse picking
+    Picker picker;
+    OcclusionBuffer occlusionBuffer(cpuOcclusion ? OCCLUSION_WIDTH : 0, cpuOcclusion ? OCCLUSION_HEIGHT : 0);
+    size_t drawableObjects = 0;
+    glm::vec4 wallColor = glm::vec4(0.2f, 0.3f, 0.3f, 1.0f);
+    {
+        // Every primitive's size is known up front, so the objects are built into one arena allocated once
+        // and the pool grows once, instead of allocating per object
+        size_t arenaSize = 0, poolVertices = 0, poolIndices = 0;
+        for (const SceneObject& object : scene.Objects) {
+            ObjectGeometry size = measureObject(object);
+            arenaSize += objectFootprint(size);
+            poolVertices += size.VertexCount;
+            poolIndices += size.IndexCount > 0 ? size.IndexCount : size.VertexCount;
+        }
+        LinearArena arena(arenaSize);
+        geometry.Reserve(poolVertices, poolIndices);
+
+        for (size_t i = 0; i < scene.Objects.size(); ++i) {
+            if (scene.Objects[i].Kind == PRIM_WALL) {
+                wallColor = scene.Objects[i].Color;
+                bounds.Add(AABB());
+                continue;
+            }
+            ObjectGeometry object = createObjectGeometry(scene.Objects[i], arena);
+            ranges[i] = geometry.Add(object.Mode, object.Vertices, object.VertexCount, object.FloatsPerVertex,
+                                     object.Indices, object.IndexCount);
+            size_t box = bounds.Add(AABB::FromVertices(object.Vertices, object.VertexCount, object.FloatsPerVertex));
+            if (object.Mode == GL_TRIANGLES)
+                picker.Add(i, object.Vertices, object.VertexCount, object.FloatsPerVertex, object.Indices, object.IndexCount);
+            if (cpuOcclusion && object.Mode == GL_TRIANGLES)
+                occlusionBuffer.AddOccluder(i, bounds.Get(box), object.Vertices, object.VertexCount, object.FloatsPerVertex,
+                                            object.Indices, object.IndexCount);
+            drawableObjects++;
+        }
+    }
+    geometry.Upload();
+    TRACE_END("geometry");
+
+    TRACE_BEGIN("bvh");
+    BVH bvh;
+    bvh.Build(bounds);
+    const bool cullWithBVH = bvh.Size() >= BVH_CULL_THRESHOLD;
+    TRACE_END("bvh");
+
+    BatchRenderer batch;
+    // Index of every scene object in the batch, -1 for the wall
+    std::vector<GLint> batchObject(scene.Objects.size(), -1);
+    // Bounding box of every batch object, in batch order
+    std::vector<AABB> batchBounds;
+    ShaderPermutations batchShaders("batch.vs", "batch.frag");
+    batchShaders.OnCompile = [](Shader& variant) {
+        variant.BindUniformBlock("FrameData", FrameUniforms::BINDING);
     };
+    if (useBatch) {
+        TRACE_SCOPE("batch");
+        batchShaders.Get(litFeature);
+        batchShaders.Get(litFeature | SHADER_TEXTURED);
+        batchShaders.Get(lineFeatures);
+        GLint batchCount = 0;
+        for (size_t i = 0; i < scene.Objects.size(); ++i) {
+            const SceneObject& object = scene.Objects[i];
+            if (object.Kind == PRIM_WALL)
+                continue;
+            batchObject[i] = batchCount++;
+            batch.Add(ranges[i], glm::mat4(1.0f), object.Color, object.Texture);
+            batchBounds.push_back(bounds.Get(i));
+        }
+        batch.Upload(geometry);
+    }
+    HiZCuller* hiz = nullptr;
+    if (gpuOcclusion) {
+        TRACE_SCOPE("hiz");
+        hiz = new HiZCuller(WIDTH, HEIGHT, batchBounds, batch.CommandCount());
+    }
+    std::cout << (useBatch ? "Using batched multi-draw-indirect renderer\n" : "Using per-object renderer\n");
+
+    // The pool and the texture array stay bound for the whole render loop
+    geometry.Bind();
+    textureLoader.Bind(0);
+
+    // The wall covers the whole window behind everything, so clearing to its colour replaces drawing it
+    glClearColor(wallColor.r, wallColor.g, wallColor.b, wallColor.a);
+
+    // Offscreen target of headless runs, of every run culling on the GPU, which reads its depth texture, and of
+    // --hover, which reads its object IDs. Other runs draw straight to the window.
+    const bool offscreen = headless || hiz || hover;
+    Framebuffer target;
+    if (offscreen) {
+        if (!target.Create(WIDTH, HEIGHT, hiz != nullptr, hover)) {
+            glfwTerminate();
+            return -1;
+        }
+        target.Bind();
+    }
 
-    glm::vec4 color29 = rgb255(163, 150, 133); // carpet color
-    std::vector<GLfloat> vertices29 = createPrismVertices(corners29,-0.5f,1.0f);
-
-    GLuint VAO29,VBO29;
-    glGenVertexArrays(1,&VAO29);
-    glGenBuffers(1,&VBO29);
-    glBindVertexArray(VAO29);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO29);
-    glBufferData(GL_ARRAY_BUFFER,vertices29.size()*sizeof(GLfloat),vertices29.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);  
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // Barn Doors --
-    // --- Left Barn Door ---
-    std::vector<std::pair<int,int>> cornersLeftDoor = {
-        {0, 594}, {201, 594}, {201, 880}, {0, 880}  // extend to very left edge
+    // The camera frames are drawn from: the interpolated simulation state, or the scripted path
+    Camera eye(initialCameraPos, camera.WorldUp, initialYaw, initialPitch);
+    eye.SetPerspective((float)WIDTH / HEIGHT, 0.1f, 100.0f);
+    // Revision of eye last written to the FrameData block and culled against
+    GLuint uploadedRevision = 0;
+    // Frustum culling result per scene object, and how many drawable objects it hid
+    std::vector<GLubyte> visible(scene.Objects.size(), 1);
+    size_t culledObjects = 0;
+    // Drawable objects the CPU occlusion buffer hid behind others
+    size_t occludedObjects = 0;
+    // Revision of eye the depth pyramid was built from. While the objects were culled against a pyramid of
+    // another camera, one more frame has to be drawn to show the objects that came into view.
+    GLuint pyramidRevision = 0;
+    bool occlusionStale = false;
+
+    // GPU time of every render pass, shown in the window title and traced to CSV with --profile
+    GpuProfiler profiler;
+    profiler.Enabled = profile;
+    const int clearPass    = profiler.AddScope("clear");
+    const int solidPass    = profiler.AddScope("solid");
+    const int texturedPass = profiler.AddScope("textured");
+    const int linePass     = profiler.AddScope("lines");
+    if (profile)
+        profiler.OpenCSV("gpu_profile.csv");
+
+    // Per-object path: every draw sorted by primitive mode and shader permutation, so each variant is bound once
+    struct DrawItem
+    {
+        GLenum Mode;
+        GLuint Features;
+        size_t Object;
     };
-
-    // --- Right Barn Door (covers support 2 and 4) ---
-    std::vector<std::pair<int,int>> cornersRightDoor = {
-        {501, 594}, {702, 594}, {702, 880}, {501, 880}  // extend to very right edge
+    auto drawOrder = [](const DrawItem& a, const DrawItem& b) {
+        return a.Mode != b.Mode ? a.Mode < b.Mode : a.Features < b.Features;
     };
+    std::vector<DrawItem> drawList;
+    if (!useBatch) {
+        for (size_t i = 0; i < scene.Objects.size(); ++i) {
+            const SceneObject& object = scene.Objects[i];
+            if (object.Kind == PRIM_WALL)
+                continue;
+            GLuint features = ranges[i].Mode == GL_LINES ? lineFeatures : litFeature;
+            if (object.Texture >= 0)
+                features |= SHADER_TEXTURED;
+            drawList.push_back(DrawItem{ ranges[i].Mode, features, i });
+        }
+        std::stable_sort(drawList.begin(), drawList.end(), drawOrder);
+        // Compile every variant now rather than on the first frame that needs it
+        for (const DrawItem& item : drawList)
+            shaders.Get(item.Features);
+    }
 
-    // Color for doors
-    glm::vec4 colorDoor = rgb255(24, 23, 21);
-
-    // Left Door vertices
-    std::vector<GLfloat> verticesLeftDoor = createPrismVertices(cornersLeftDoor, -0.47f, -0.5f);
-    GLuint VAOLeftDoor, VBOLeftDoor;
-    glGenVertexArrays(1, &VAOLeftDoor);
-    glGenBuffers(1, &VBOLeftDoor);
-    glBindVertexArray(VAOLeftDoor);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOLeftDoor);
-    glBufferData(GL_ARRAY_BUFFER, verticesLeftDoor.size() * sizeof(GLfloat), verticesLeftDoor.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // Right Door vertices
-    std::vector<GLfloat> verticesRightDoor = createPrismVertices(cornersRightDoor, -0.47f, -0.5f);
-    GLuint VAORightDoor, VBORightDoor;
-    glGenVertexArrays(1, &VAORightDoor);
-    glGenBuffers(1, &VBORightDoor);
-    glBindVertexArray(VAORightDoor);
-    glBindBuffer(GL_ARRAY_BUFFER, VBORightDoor);
-    glBufferData(GL_ARRAY_BUFFER, verticesRightDoor.size() * sizeof(GLfloat), verticesRightDoor.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- X on Left Door ---
-    std::vector<GLfloat> verticesLeftX = {
-        // diagonal from top-left to bottom-right
-        screenToNDC_X(14),  screenToNDC_Y(594), -0.46f,
-        screenToNDC_X(201), screenToNDC_Y(880), -0.46f,
-
-        // diagonal from bottom-left to top-right
-        screenToNDC_X(14),  screenToNDC_Y(880), -0.46f,
-        screenToNDC_X(201), screenToNDC_Y(594), -0.46f
+    // Draws the run of the draw list using one permutation and primitive mode
+    auto drawObjects = [&](GLuint features, GLenum mode) {
+        std::pair<std::vector<DrawItem>::iterator, std::vector<DrawItem>::iterator> run =
+            std::equal_range(drawList.begin(), drawList.end(), DrawItem{ mode, features, 0 }, drawOrder);
+        if (run.first == run.second)
+            return;
+
+        Shader& variant = shaders.Get(features);
+        variant.Use();
+        // Textured variants sample their layer of the texture array instead of a solid colour
+        const GLint location = variant.Uniform(features & SHADER_TEXTURED ? UniformHash("textureLayer") : UniformHash("prismColor"));
+        const GLint idLocation = variant.Uniform(UniformHash("objectId"));
+        for (std::vector<DrawItem>::iterator item = run.first; item != run.second; ++item) {
+            if (!visible[item->Object])
+                continue;
+            const SceneObject& object = scene.Objects[item->Object];
+            if (features & SHADER_TEXTURED)
+                variant.SetInt(location, object.Texture);
+            else
+                variant.SetVec4(location, object.Color);
+            if (features & SHADER_OBJECT_ID)
+                variant.SetUInt(idLocation, (GLuint)item->Object + 1);
+            geometry.Draw(ranges[item->Object]);
+        }
     };
 
-    GLuint VAOLX, VBOLX;
-    glGenVertexArrays(1, &VAOLX);
-    glGenBuffers(1, &VBOLX);
-    glBindVertexArray(VAOLX);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOLX);
-    glBufferData(GL_ARRAY_BUFFER, verticesLeftX.size() * sizeof(GLfloat), verticesLeftX.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- X on Right Door ---
-    std::vector<GLfloat> verticesRightX = {
-        screenToNDC_X(501), screenToNDC_Y(594), -0.46f,
-        screenToNDC_X(688), screenToNDC_Y(880), -0.46f,
-
-        screenToNDC_X(501), screenToNDC_Y(880), -0.46f,
-        screenToNDC_X(688), screenToNDC_Y(594), -0.46f
+    // Draws one frame of the scene seen from eye into the bound framebuffer, time is in seconds
+    auto drawScene = [&](GLfloat time) {
+        TRACE_SCOPE("drawScene");
+        profiler.BeginFrame();
+
+        // Clear screen to the wall colour
+        {
+            TRACE_SCOPE("clear");
+            GpuScope scope(profiler, clearPass);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            if (hover)
+                target.ClearObjectIds();
+        }
+
+        // --- Camera data for this frame ---
+        // The camera part of the block is only uploaded, and the objects only culled, when the camera moved
+        if (eye.Revision() != uploadedRevision) {
+            frameUniforms.UpdateCamera(eye.GetViewMatrix(), eye.GetProjectionMatrix(), eye.GetViewProjectionMatrix(), eye.Position);
+            uploadedRevision = eye.Revision();
+
+            TRACE_SCOPE("cull");
+            if (cullWithBVH)
+                bvh.CullFrustum(eye.GetFrustumPlanes(), visible);
+            else
+                bounds.CullFrustum(eye.GetFrustumPlanes(), visible);
+            // The occluders are only drawn when they passed the frustum test
+            if (cpuOcclusion)
+                occlusionBuffer.Render(eye.GetViewProjectionMatrix(), visible);
+            culledObjects = 0;
+            occludedObjects = 0;
+            for (size_t i = 0; i < scene.Objects.size(); ++i) {
+                if (scene.Objects[i].Kind == PRIM_WALL)
+                    continue;
+                if (!visible[i]) {
+                    culledObjects++;
+                } else if (cpuOcclusion && occlusionBuffer.Occluded(bounds.Get(i))) {
+                    visible[i] = 0;
+                    occludedObjects++;
+                }
+                if (useBatch)
+                    batch.SetVisible(batchObject[i], visible[i] != 0);
+            }
+            if (useBatch)
+                batch.UpdateVisibility();
+        }
+        frameUniforms.UpdateTime(time);
+
+        // Hide the batch objects behind the depth of the previous frame
+        GLuint commands = useBatch ? batch.CommandBuffer() : 0;
+        if (hiz) {
+            TRACE_SCOPE("occlusion");
+            hiz->Cull(commands);
+            commands = hiz->Commands();
+            occlusionStale = pyramidRevision != eye.Revision();
+        }
+
+        // --- Draw 3D objects ---
+        // Triangles: solid and textured objects each in one submission when batching, one draw each on 3.3
+        // contexts. Both paths use a separate shader permutation for textured objects.
+        {
+            TRACE_SCOPE("solid");
+            GpuScope scope(profiler, solidPass);
+            if (useBatch) {
+                batchShaders.Get(litFeature).Use();
+                batch.Draw(GL_TRIANGLES, false, commands);
+            } else {
+                drawObjects(litFeature, GL_TRIANGLES);
+            }
+        }
+
+        {
+            TRACE_SCOPE("textured");
+            GpuScope scope(profiler, texturedPass);
+            if (useBatch) {
+                batchShaders.Get(litFeature | SHADER_TEXTURED).Use();
+                batch.Draw(GL_TRIANGLES, true, commands);
+            } else {
+                drawObjects(litFeature | SHADER_TEXTURED, GL_TRIANGLES);
+            }
+        }
+
+        // Lines (the X on the barn doors)
+        {
+            TRACE_SCOPE("lines");
+            GpuScope scope(profiler, linePass);
+            if (useBatch) {
+                batchShaders.Get(lineFeatures).Use();
+                batch.Draw(GL_LINES, false, commands);
+            } else {
+                drawObjects(lineFeatures, GL_LINES);
+            }
+        }
+
+        // Depth pyramid for culling the next frame
+        if (hiz) {
+            TRACE_SCOPE("hizPyramid");
+            hiz->BuildPyramid(target.DepthBuffer, eye.GetViewProjectionMatrix());
+            pyramidRevision = eye.Revision();
+        }
+
+        profiler.EndFrame();
     };
 
-    GLuint VAORX, VBORX;
-    glGenVertexArrays(1, &VAORX);
-    glGenBuffers(1, &VBORX);
-    glBindVertexArray(VAORX);
-    glBindBuffer(GL_ARRAY_BUFFER, VBORX);
-    glBufferData(GL_ARRAY_BUFFER, verticesRightX.size() * sizeof(GLfloat), verticesRightX.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- Barn Door Knobs ---
-    // Left door knob (right side, near center)
-    float leftKnobX = 201.0f - 8.0f; // slightly inset from center edge
-    float leftKnobY = (594 + 880) / 2.0f; // vertical center
-    float knobRadius = 5.0f;
-
-    std::vector<GLfloat> verticesLeftKnob = createCircleVertices(leftKnobX, leftKnobY, -0.46f, knobRadius);
-    GLuint VAOLeftKnob, VBOLefKnob;
-    glGenVertexArrays(1,&VAOLeftKnob);
-    glGenBuffers(1,&VBOLefKnob);
-    glBindVertexArray(VAOLeftKnob);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOLefKnob);
-    glBufferData(GL_ARRAY_BUFFER, verticesLeftKnob.size()*sizeof(GLfloat), verticesLeftKnob.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // Right door knob (left side, near center)
-    float rightKnobX = 501.0f + 8.0f; // slightly inset from center edge
-    float rightKnobY = (594 + 880) / 2.0f;
-
-    std::vector<GLfloat> verticesRightKnob = createCircleVertices(rightKnobX, rightKnobY, -0.46f, knobRadius);
-    GLuint VAORightKnob, VBORightKnob;
-    glGenVertexArrays(1,&VAORightKnob);
-    glGenBuffers(1,&VBORightKnob);
-    glBindVertexArray(VAORightKnob);
-    glBindBuffer(GL_ARRAY_BUFFER, VBORightKnob);
-    glBufferData(GL_ARRAY_BUFFER, verticesRightKnob.size()*sizeof(GLfloat), verticesRightKnob.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(GLfloat),(GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // --- Circle Hole ---
-    const int holeSegments = 32;
-    float holeRadius = 10.0f; // pixels
-    float holeX = 356.0f;     // pixel X
-    float holeY = 644.0f;     // pixel Y
-    float holeZ = -0.8f;     // adjustable Z-depth
-
-    float aspect = (float)HEIGHT / (float)WIDTH; // H / W
-    float cx = screenToNDC_X(holeX);
-    float cy = screenToNDC_Y(holeY);
-
-    // Generate vertices
-    std::vector<GLfloat> verticesHole;
-    for(int i = 0; i <= holeSegments; ++i) {
-        float theta = 2.0f * 3.1415926f * float(i) / float(holeSegments);
-        float x = cx + (screenToNDC_X(holeRadius) - screenToNDC_X(0)) * cos(theta);
-        float y = cy + (screenToNDC_Y(holeRadius) - screenToNDC_Y(0)) * sin(theta); // NO / aspect
-
-        verticesHole.push_back(x);
-        verticesHole.push_back(y);
-        verticesHole.push_back(holeZ); // use adjustable Z
+    // --- Scripted runs: follow the camera path for a fixed number of frames ---
+    // --headless renders offscreen and writes every frame to disk, --bench times every frame instead.
+    if (headless || bench) {
+        // Every frame of a scripted run shows the final textures
+        textureLoader.Finish();
+
+        if (headless && !bench) {
+            std::error_code error;
+            std::filesystem::create_directories(outputDir, error);
+        }
+        // Benchmark frames must not wait for vsync
+        if (bench)
+            glfwSwapInterval(0);
+
+        Benchmark* benchmark = bench ? new Benchmark() : nullptr;
+        CameraPath path;
+        int written = 0;
+        for (int frame = 0; frame < pathFrames; ++frame) {
+            TRACE_SCOPE("frame");
+            CameraPose pose = path.Sample(pathFrames > 1 ? (float)frame / (pathFrames - 1) : 0.0f);
+
+            if (benchmark)
+                benchmark->BeginFrame();
+            eye.SetPose(pose.Position, pose.Yaw, pose.Pitch);
+            drawScene(frame / 60.0f); // fixed 60 Hz clock so runs are reproducible
+            if (benchmark)
+                benchmark->EndSubmit();
+
+            if (!headless) {
+                TRACE_SCOPE("swap");
+                if (offscreen)
+                    target.Present();
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            } else if (!bench) {
+                TRACE_SCOPE("savePPM");
+                char name[32];
+                snprintf(name, sizeof(name), "/frame_%04d.ppm", frame);
+                if (!target.SavePPM(outputDir + name))
+                    break;
+                written++;
+            }
+        }
+
+        if (benchmark) {
+            benchmark->Finish();
+            benchmark->WriteJSON("bench_output.txt", useBatch ? "batched" : "classic");
+            delete benchmark;
+        } else {
+            std::cout << "Wrote " << written << " frames to " << outputDir << std::endl;
+        }
+        glfwSetWindowShouldClose(window, GL_TRUE);
     }
 
-    // Create VAO/VBO
-    GLuint VAOHole, VBOHole;
-    glGenVertexArrays(1, &VAOHole);
-    glGenBuffers(1, &VBOHole);
-    glBindVertexArray(VAOHole);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOHole);
-    glBufferData(GL_ARRAY_BUFFER, verticesHole.size() * sizeof(GLfloat), verticesHole.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-
+    // Edited shader files are recompiled between frames while the window is open
+    FileWatcher shaderWatcher;
+    shaderWatcher.OnChange = glfwPostEmptyEvent; // wake the render loop if it is waiting for events
+    if (!glfwWindowShouldClose(window)) {
+        for (const char* path : { "basic.vs", "basic.frag", "batch.vs", "batch.frag" })
+            shaderWatcher.Watch(path);
+    }
+    std::vector<std::string> changedFiles;
+
+    // Object under the cursor with --hover, as written to the ID buffer (0 for none)
+    ObjectIdReadback idReadback;
+    GLuint hoveredObject = 0;
+    if (hover) {
+        idReadback.Create();
+        frameUniforms.UpdateHighlight(hoveredObject);
+    }
 
     // --- Render loop ---
+    // Frames are only drawn when something changed: the camera moved, a texture or shader was replaced, or the
+    // window needs repainting. Otherwise the last frame stays on screen and the loop sleeps in
+    // glfwWaitEventsTimeout. --profile and --continuous draw every frame.
+    const bool redrawAlways = continuous || profile;
+    double lastOverlayUpdate = 0.0;
+    // Camera simulation at 120 Hz, previousPose is the state before the last step
+    FixedTimestep timestep(1.0 / 120.0);
+    CameraPose previousPose = { camera.Position, camera.Yaw, camera.Pitch };
+    double previousTime = glfwGetTime();
+    double waitTimeout = 0.0; // 0 polls for events without sleeping
     while(!glfwWindowShouldClose(window))
     {
-        glfwPollEvents();
-
-            // Camera movement
-        float cameraSpeed = 0.01f;                // forward/backward speed
-        float strafeSpeed = cameraSpeed * 0.5f;   // left/right speed is half
-        float angleSpeed  = 0.25f;                 // degrees per key press/frame
-
-        glm::vec3 right = glm::normalize(glm::cross(cameraFront, cameraUp));
-
-        // Position controls (WASD)
-        if(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) cameraPos += cameraSpeed * cameraUp;
-        if(glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) cameraPos -= cameraSpeed * cameraUp;
-        if(glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) cameraPos += cameraSpeed * cameraFront;
-        if(glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) cameraPos -= cameraSpeed * cameraFront;
-        if(glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) cameraPos -= strafeSpeed * right;
-        if(glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) cameraPos += strafeSpeed * right;
-
-        // Clamp vertical movement
-        cameraPos.y = glm::clamp(cameraPos.y, -5.0f, 5.0f);
-
-        // Rotation controls (Arrow Keys)
-        if(glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)  yaw   -= angleSpeed;
-        if(glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) yaw   += angleSpeed;
-        if(glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)    pitch += angleSpeed;
-        if(glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)  pitch -= angleSpeed;
-
-        // Constrain pitch to avoid flipping
-        if(pitch > 89.0f) pitch = 89.0f;
-        if(pitch < -89.0f) pitch = -89.0f;
-
-        // Recalculate cameraFront from yaw/pitch
-        glm::vec3 front;
-        front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
-        front.y = sin(glm::radians(pitch));
-        front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
-        cameraFront = glm::normalize(front);
-
-
-        // Clear screen
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        shader.Use();
-
-        // --- Draw wall first ---
-        glDisable(GL_DEPTH_TEST); // ensure wall is always in back
-        glm::mat4 identity = glm::mat4(1.0f);
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "model"), 1, GL_FALSE, glm::value_ptr(identity));
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "view"), 1, GL_FALSE, glm::value_ptr(identity));
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "projection"), 1, GL_FALSE, glm::value_ptr(identity));
-
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color3));
-        glBindVertexArray(VAO3);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
-        glEnable(GL_DEPTH_TEST); // re-enable for 3D objects
-
-        // --- Draw 3D objects ---
-        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / HEIGHT, 0.1f, 100.0f);
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "view"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "model"), 1, GL_FALSE, glm::value_ptr(identity));
-
-        // Draw glasses case
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color1));
-        glBindVertexArray(VAO1);
-        glDrawArrays(GL_TRIANGLES, 0, vertices1.size()/3);
-        glBindVertexArray(0);
-
-        // Draw bible
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color2));
-        glBindVertexArray(VAO2);
-        glDrawArrays(GL_TRIANGLES, 0, vertices2.size()/3);
-        glBindVertexArray(0);
-
-        // Draw dvd player pt1
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color4));
-        glBindVertexArray(VAO4);
-        glDrawArrays(GL_TRIANGLES, 0, vertices4.size()/3);
-        glBindVertexArray(0);
-
-        // Draw dvd player pt2
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color5));
-        glBindVertexArray(VAO5);
-        glDrawArrays(GL_TRIANGLES, 0, vertices5.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Cabinet Top
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color6));
-        glBindVertexArray(VAO6);
-        glDrawArrays(GL_TRIANGLES, 0, vertices6.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Cabinet Base
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color7));
-        glBindVertexArray(VAO7);
-        glDrawArrays(GL_TRIANGLES, 0, vertices7.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Cabinet Base Support 1
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color8));
-        glBindVertexArray(VAO8);
-        glDrawArrays(GL_TRIANGLES, 0, vertices8.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Cabinet Base Support 2
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color9));
-        glBindVertexArray(VAO9);
-        glDrawArrays(GL_TRIANGLES, 0, vertices9.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Cabinet Base Support 2
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color10));
-        glBindVertexArray(VAO10);
-        glDrawArrays(GL_TRIANGLES, 0, vertices10.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Shelf
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color11));
-        glBindVertexArray(VAO11);
-        glDrawArrays(GL_TRIANGLES, 0, vertices11.size()/3);
-        glBindVertexArray(0);
-
-        // Draw TV
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color12));
-        glBindVertexArray(VAO12);
-        glDrawArrays(GL_TRIANGLES, 0, vertices12.size()/3);
-        glBindVertexArray(0);
-
-        // Draw TV boarder
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color13));
-        glBindVertexArray(VAO13);
-        glDrawArrays(GL_TRIANGLES, 0, vertices13.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Switch case
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color14));
-        glBindVertexArray(VAO14);
-        glDrawArrays(GL_TRIANGLES, 0, vertices14.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Switch case zipper
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color15));
-        glBindVertexArray(VAO15);
-        glDrawArrays(GL_TRIANGLES, 0, vertices15.size()/3);
-        glBindVertexArray(0);
-
-        // Draw waterbottle
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color16));
-        glBindVertexArray(VAO16);
-        glDrawArrays(GL_TRIANGLES, 0, vertices16.size()/3);
-        glBindVertexArray(0);
-
-        // Draw waterbottle neck
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color17));
-        glBindVertexArray(VAO17);
-        glDrawArrays(GL_TRIANGLES, 0, vertices17.size()/3);
-        glBindVertexArray(0);
-
-        // Draw waterbottle silver ring
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color18));
-        glBindVertexArray(VAO18);
-        glDrawArrays(GL_TRIANGLES, 0, vertices18.size()/3);
-        glBindVertexArray(0);
-
-        // Draw waterbottle Lid
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color19));
-        glBindVertexArray(VAO19);
-        glDrawArrays(GL_TRIANGLES, 0, vertices19.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Cabinet Base Support 3
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color20));
-        glBindVertexArray(VAO20);
-        glDrawArrays(GL_TRIANGLES, 0, vertices20.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Cabinet Base Support 4
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color21));
-        glBindVertexArray(VAO21);
-        glDrawArrays(GL_TRIANGLES, 0, vertices21.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Switch Dock
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color22));
-        glBindVertexArray(VAO22);
-        glDrawArrays(GL_TRIANGLES, 0, vertices22.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Switch
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color23));
-        glBindVertexArray(VAO23);
-        glDrawArrays(GL_TRIANGLES, 0, vertices23.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Joy Con L
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color24));
-        glBindVertexArray(VAO24);
-        glDrawArrays(GL_TRIANGLES, 0, vertices24.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Joy Con R
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color25));
-        glBindVertexArray(VAO25);
-        glDrawArrays(GL_TRIANGLES, 0, vertices25.size()/3);
-        glBindVertexArray(0);
-
-        // Draw TV Stand 1
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color26));
-        glBindVertexArray(VAO26);
-        glDrawArrays(GL_TRIANGLES, 0, vertices26.size()/3);
-        glBindVertexArray(0);
-
-        // Draw TV Stand 2
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color27));
-        glBindVertexArray(VAO27);
-        glDrawArrays(GL_TRIANGLES, 0, vertices27.size()/3);
-        glBindVertexArray(0);
-
-        // Draw TV Stand 3
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color30));
-        glBindVertexArray(VAO30);
-        glDrawArrays(GL_TRIANGLES, 0, vertices30.size()/3);
-        glBindVertexArray(0);
-
-        // Draw TV Stand 4
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color31));
-        glBindVertexArray(VAO31);
-        glDrawArrays(GL_TRIANGLES, 0, vertices31.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Kleenex Box with texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, kleenexTexture);
-        glUniform1i(glGetUniformLocation(shader.Program, "ourTexture"), 0);
-        glUniform1i(glGetUniformLocation(shader.Program, "useTexture"), GL_TRUE);
-        glBindVertexArray(VAO28);
-        glDrawArrays(GL_TRIANGLES, 0, vertices28.size()/5); // Divide by 5 for x,y,z,s,t
-        glBindVertexArray(0);
-        glUniform1i(glGetUniformLocation(shader.Program, "useTexture"), GL_FALSE);
-
-        // Draw Carpet
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(color29));
-        glBindVertexArray(VAO29);
-        glDrawArrays(GL_TRIANGLES, 0, vertices29.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Left Barn Door
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(colorDoor));
-        glBindVertexArray(VAOLeftDoor);
-        glDrawArrays(GL_TRIANGLES, 0, verticesLeftDoor.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Right Barn Door
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(colorDoor));
-        glBindVertexArray(VAORightDoor);
-        glDrawArrays(GL_TRIANGLES, 0, verticesRightDoor.size()/3);
-        glBindVertexArray(0);
-
-        // Draw X on Left Door
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(rgb255(40,39,36))); // grey
-        glBindVertexArray(VAOLX);
-        glDrawArrays(GL_LINES, 0, verticesLeftX.size()/3);
-        glBindVertexArray(0);
-
-        // Draw X on Right Door
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(rgb255(40,39,36))); // grey
-        glBindVertexArray(VAORX);
-        glDrawArrays(GL_LINES, 0, verticesRightX.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Left Door Knob
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(rgb255(40,39,36)));
-        glBindVertexArray(VAOLeftKnob);
-        glDrawArrays(GL_TRIANGLES, 0, verticesLeftKnob.size()/3);
-        glBindVertexArray(0);
-
-        // Draw Right Door Knob
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(rgb255(40,39,36)));
-        glBindVertexArray(VAORightKnob);
-        glDrawArrays(GL_TRIANGLES, 0, verticesRightKnob.size()/3);
-        glBindVertexArray(0);
-
-        // Draw the circle hole
-        glUniform4fv(glGetUniformLocation(shader.Program, "prismColor"), 1, glm::value_ptr(rgb255(42,39,32)));
-        glBindVertexArray(VAOHole);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, verticesHole.size()/3);
-        glBindVertexArray(0);
-
-        glfwSwapBuffers(window);
+        TRACE_SCOPE("frame");
+        TRACE_BEGIN("input");
+        if (waitTimeout > 0.0) {
+            glfwWaitEventsTimeout(waitTimeout);
+            // The time spent waiting is not simulated, the first key press moves the camera by one step at once
+            previousTime = glfwGetTime() - timestep.Step;
+        } else {
+            glfwPollEvents();
+        }
+        CameraInput input = sampleCameraInput(window);
+
+        // Cast a ray through the cursor with the camera of the frame on screen
+        if (pickRequested) {
+            TRACE_SCOPE("pick");
+            pickRequested = false;
+            double cursorX, cursorY;
+            glfwGetCursorPos(window, &cursorX, &cursorY);
+            double start = glfwGetTime();
+            glm::vec3 origin, direction;
+            Picker::CursorRay(eye.GetViewProjectionMatrix(), cursorX, cursorY, WIDTH, HEIGHT, origin, direction);
+            PickResult pick = picker.Pick(bvh, origin, direction);
+            double micros = (glfwGetTime() - start) * 1e6;
+            if (pick.Object >= 0)
+                printf("Picked %s (object %d) at (%.3f, %.3f, %.3f) in %.1f us\n", scene.Names[pick.Object].c_str(),
+                       pick.Object, pick.Point.x, pick.Point.y, pick.Point.z, micros);
+            else
+                printf("Picked nothing in %.1f us\n", micros);
+        }
+        TRACE_END("input");
+
+        bool damaged = windowDamaged;
+        windowDamaged = false;
+
+        // Upload whatever textures finished decoding since the last frame
+        if (textureLoader.Update() > 0)
+            damaged = true;
+
+        if (shaderWatcher.Poll(changedFiles)) {
+            TRACE_SCOPE("shaderReload");
+            for (const std::string& path : changedFiles) {
+                int reloaded = shaders.Reload(path) + batchShaders.Reload(path);
+                if (reloaded > 0) {
+                    std::cout << "Reloaded " << path << " (" << reloaded << " programs)\n";
+                    damaged = true;
+                }
+            }
+        }
+
+        // An ID read that finished since the last frame moves the highlight
+        GLuint hoverId;
+        if (hover && idReadback.Poll(hoverId) && hoverId != hoveredObject) {
+            hoveredObject = hoverId;
+            frameUniforms.UpdateHighlight(hoveredObject);
+            damaged = true;
+        }
+
+        // The camera moves in fixed steps, so its speed no longer depends on the frame rate
+        double now = glfwGetTime();
+        {
+            TRACE_SCOPE("simulate");
+            int steps = timestep.Advance(now - previousTime);
+            for (int i = 0; i < steps; ++i) {
+                previousPose = CameraPose{ camera.Position, camera.Yaw, camera.Pitch };
+                stepCamera(input, (GLfloat)timestep.Step);
+            }
+        }
+        previousTime = now;
+
+        // Render the camera between the last two steps by the time left in the accumulator. While it stands
+        // still both steps are equal, lerp() returns them bit for bit, so the pose does not change and the
+        // cached matrices are reused.
+        GLfloat alpha = timestep.Alpha();
+        eye.SetPose(lerp(previousPose.Position, camera.Position, alpha),
+                    lerp(previousPose.Yaw, camera.Yaw, alpha),
+                    lerp(previousPose.Pitch, camera.Pitch, alpha));
+        if (eye.Revision() != uploadedRevision || occlusionStale)
+            damaged = true;
+
+        bool draw = damaged || redrawAlways;
+        if (draw) {
+            drawScene((GLfloat)now);
+
+            // Stats overlay in the window title, refreshed twice a second
+            if (profile && glfwGetTime() - lastOverlayUpdate > 0.5) {
+                lastOverlayUpdate = glfwGetTime();
+                // Reading the GPU count waits for the culling pass, acceptable twice a second
+                size_t occluded = hiz ? hiz->OccludedCount() : occludedObjects;
+                char culling[96];
+                snprintf(culling, sizeof(culling), "drawn %zu/%zu (%zu culled, %zu occluded) | ",
+                         drawableObjects - culledObjects - occluded, drawableObjects, culledObjects, occluded);
+                glfwSetWindowTitle(window, ("Prisms | " + std::string(culling) + profiler.Summary()).c_str());
+            }
+
+            TRACE_BEGIN("swap");
+            if (offscreen)
+                target.Present();
+            glfwSwapBuffers(window);
+            TRACE_END("swap");
+        }
+
+        // Queue a read of the ID under the cursor when it moved or the frame below it changed, it is collected
+        // by a later iteration without waiting for the GPU
+        if (hover && (cursorMoved || draw)) {
+            double cursorX, cursorY;
+            glfwGetCursorPos(window, &cursorX, &cursorY);
+            GLint x = (GLint)cursorX, y = (GLint)HEIGHT - 1 - (GLint)cursorY;
+            if (x >= 0 && y >= 0 && x < (GLint)WIDTH && y < (GLint)HEIGHT) {
+                if (idReadback.Request(target, x, y))
+                    cursorMoved = false;
+            } else {
+                cursorMoved = false;
+                if (hoveredObject != 0) {
+                    hoveredObject = 0;
+                    frameUniforms.UpdateHighlight(hoveredObject);
+                    windowDamaged = true;
+                }
+            }
+        }
+
+        // Keep going at the swap rate while a key is held, the camera is still settling between two different
+        // steps or the occlusion culling needs its extra frame, check back soon while ID reads are in flight,
+        // sleep otherwise
+        bool moving = input.Up != 0.0f || input.Forward != 0.0f || input.Right != 0.0f ||
+                      input.Yaw != 0.0f || input.Pitch != 0.0f ||
+                      previousPose.Position != camera.Position ||
+                      previousPose.Yaw != camera.Yaw || previousPose.Pitch != camera.Pitch;
+        if (redrawAlways || (draw && moving) || occlusionStale)
+            waitTimeout = 0.0;
+        else if (moving || textureLoader.Pending() > 0 || idReadback.Pending())
+            waitTimeout = BUSY_TIMEOUT;
+        else
+            waitTimeout = IDLE_TIMEOUT;
     }
 
     // Clean memory
-    glDeleteVertexArrays(1,&VAO1); glDeleteBuffers(1,&VBO1);
-    glDeleteVertexArrays(1,&VAO2); glDeleteBuffers(1,&VBO2);
-    glDeleteVertexArrays(1,&VAO3); glDeleteBuffers(1,&VBO3);
+    shaderWatcher.Stop(); // OnChange posts GLFW events, so the thread must be gone before glfwTerminate()
+    if (hover)
+        idReadback.Release();
+    delete hiz;
+    if (target.FBO != 0)
+        target.Release();
+    if (useBatch)
+        batch.Release();
+    batchShaders.Release();
+    shaders.Release();
+    textureLoader.Release();
+    profiler.Release();
+    frameUniforms.Release();
+    geometry.Release();
     glfwTerminate();
+    TRACE_FLUSH("trace.json");
     return 0;
 }
 
@@ -1249,53 +1005,29 @@ void key_callback(GLFWwindow* window,int key,int scancode,int action,int mode)
     if(key==GLFW_KEY_C && (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS ||
                            glfwGetKey(window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS))
     {
-        cameraPos = initialCameraPos;
-        cameraFront = initialCameraFront;
-        yaw = initialYaw;
-        pitch = initialPitch;
+        camera.SetPose(initialCameraPos, initialYaw, initialPitch);
         std::cout << "Camera reset to initial position.\n";
     }
 }
 
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
-    // Adjust camera position based on scroll
-    cameraPos += cameraFront * static_cast<float>(yoffset) * 0.1f;
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+        pickRequested = true;
 }
 
-// Load a texture from file
-GLuint loadTexture(const char* path) {
-    // Generate texture ID and load texture data
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        // Set texture parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    } else {
-        std::cerr << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-        return 0;
-    }
+void cursor_pos_callback(GLFWwindow* window, double x, double y)
+{
+    cursorMoved = true;
+}
 
-    return textureID;
+void refresh_callback(GLFWwindow* window)
+{
+    windowDamaged = true;
+}
+
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    // Adjust camera position based on scroll
+    camera.SetPose(camera.Position + camera.Front * static_cast<float>(yoffset) * 0.1f, camera.Yaw, camera.Pitch);
 }
@@ -1,17 +1,48 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+#ifdef OBJECT_ID
+layout (location = 1) out uint FragObjectId;
+#endif
 
 in vec2 TexCoord;
+#ifdef LIT
+in vec3 WorldPosition;
+#endif
+#ifdef OBJECT_ID
+flat in uint ObjectId;
+flat in float Highlight;
+#endif
 
+// Compiled once per feature set (see ShaderPermutations.h) instead of branching per fragment
+#ifdef TEXTURED
+uniform sampler2DArray ourTexture;
+uniform int textureLayer;
+#else
 uniform vec4 prismColor;
-uniform sampler2D ourTexture;
-uniform bool useTexture;
+#endif
+
+#ifdef OBJECT_ID
+const vec3 highlightColor = vec3(1.0, 0.85, 0.3);
+#endif
+#ifdef LIT
+const vec3 lightDirection = normalize(vec3(-0.4, 0.8, 0.6));
+#endif
 
 void main()
 {
-    if (useTexture) {
-        FragColor = texture(ourTexture, TexCoord);
-    } else {
-        FragColor = prismColor;
-    }
+#ifdef TEXTURED
+    vec4 color = texture(ourTexture, vec3(TexCoord, textureLayer));
+#else
+    vec4 color = prismColor;
+#endif
+#ifdef LIT
+    // Flat face normal from the screen-space derivatives, faces aren't wound consistently so both sides are lit
+    vec3 normal = normalize(cross(dFdx(WorldPosition), dFdy(WorldPosition)));
+    color.rgb *= 0.35 + 0.65 * abs(dot(normal, lightDirection));
+#endif
+#ifdef OBJECT_ID
+    color.rgb = mix(color.rgb, highlightColor, 0.4 * Highlight);
+    FragObjectId = ObjectId;
+#endif
+    FragColor = color;
 }
@@ -3,13 +3,41 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec2 texCoord;
 
 out vec2 TexCoord;
+#ifdef LIT
+out vec3 WorldPosition;
+#endif
+#ifdef OBJECT_ID
+flat out uint ObjectId;
+flat out float Highlight;
+#endif
+
+// Camera data shared by every program, written once per frame
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    float time;
+    uint highlightObject;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#ifdef OBJECT_ID
+// Scene object index + 1, 0 is the background
+uniform uint objectId;
+#endif
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(position, 1.0);
+    vec4 world = model * vec4(position, 1.0);
+    gl_Position = viewProjection * world;
     TexCoord = texCoord;
+#ifdef LIT
+    WorldPosition = world.xyz;
+#endif
+#ifdef OBJECT_ID
+    ObjectId = objectId;
+    Highlight = objectId == highlightObject ? 1.0 : 0.0;
+#endif
 }
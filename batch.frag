@@ -0,0 +1,48 @@
+#version 430 core
+layout (location = 0) out vec4 FragColor;
+#ifdef OBJECT_ID
+layout (location = 1) out uint FragObjectId;
+#endif
+
+#ifdef TEXTURED
+in vec2 TexCoord;
+flat in int Layer;
+#else
+flat in vec4 Color;
+#endif
+#ifdef LIT
+in vec3 WorldPosition;
+#endif
+#ifdef OBJECT_ID
+flat in uint ObjectId;
+flat in float Highlight;
+#endif
+
+#ifdef TEXTURED
+layout (binding = 0) uniform sampler2DArray textures;
+#endif
+
+#ifdef OBJECT_ID
+const vec3 highlightColor = vec3(1.0, 0.85, 0.3);
+#endif
+#ifdef LIT
+const vec3 lightDirection = normalize(vec3(-0.4, 0.8, 0.6));
+#endif
+
+void main()
+{
+#ifdef TEXTURED
+    vec4 color = texture(textures, vec3(TexCoord, Layer));
+#else
+    vec4 color = Color;
+#endif
+#ifdef LIT
+    vec3 normal = normalize(cross(dFdx(WorldPosition), dFdy(WorldPosition)));
+    color.rgb *= 0.35 + 0.65 * abs(dot(normal, lightDirection));
+#endif
+#ifdef OBJECT_ID
+    color.rgb = mix(color.rgb, highlightColor, 0.4 * Highlight);
+    FragObjectId = ObjectId;
+#endif
+    FragColor = color;
+}
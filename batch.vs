@@ -0,0 +1,63 @@
+#version 430 core
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec2 texCoord;
+layout (location = 2) in uint objectIndex;
+
+// Per-object data, indexed by the draw's base instance through objectIndex
+struct ObjectData
+{
+    mat4 model;
+    vec4 color;
+    int layer; // texture array layer, -1 when untextured
+};
+layout (std430, binding = 0) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+// Camera data shared by every program, written once per frame
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    float time;
+    uint highlightObject;
+};
+
+// Compiled once per feature set (see ShaderPermutations.h), textured and solid objects are separate batches
+#ifdef TEXTURED
+out vec2 TexCoord;
+flat out int Layer;
+#else
+flat out vec4 Color;
+#endif
+#ifdef LIT
+out vec3 WorldPosition;
+#endif
+#ifdef OBJECT_ID
+// Batch object index + 1, 0 is the background
+flat out uint ObjectId;
+flat out float Highlight;
+#endif
+
+void main()
+{
+    ObjectData object = objects[objectIndex];
+    vec4 world = object.model * vec4(position, 1.0);
+    gl_Position = viewProjection * world;
+#ifdef TEXTURED
+    TexCoord = texCoord;
+    Layer = object.layer;
+#else
+    Color = object.color;
+#endif
+#ifdef LIT
+    WorldPosition = world.xyz;
+#endif
+#ifdef OBJECT_ID
+    ObjectId = objectIndex + 1u;
+    Highlight = ObjectId == highlightObject ? 1.0 : 0.0;
+#endif
+}
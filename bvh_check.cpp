@@ -0,0 +1,165 @@
+// ======================================================
+// BVH check
+// Compares the BVH's frustum, ray and overlap queries against testing every box of random scenes
+// Usage: ./bvh_check [--seed N]
+// ======================================================
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "BVH.h"
+
+
+// Brute force ray test: index of the nearest box hit within maxDistance, or -1
+static GLint raycastAll(const BoundsArray& bounds, const glm::vec3& origin, const glm::vec3& direction,
+                        GLfloat maxDistance, GLfloat& distance)
+{
+    GLint hit = -1;
+    distance = maxDistance;
+    for (size_t i = 0; i < bounds.Size(); ++i) {
+        AABB box = bounds.Get(i);
+        if (box.Empty())
+            continue;
+        glm::vec3 t0 = (box.Min - origin) / direction, t1 = (box.Max - origin) / direction;
+        glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+        GLfloat enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        GLfloat exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, distance));
+        if (enter <= exit && enter < distance) {
+            distance = enter;
+            hit = (GLint)i;
+        }
+    }
+    return hit;
+}
+
+static size_t overlapAll(const BoundsArray& bounds, const AABB& query)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < bounds.Size(); ++i) {
+        AABB box = bounds.Get(i);
+        if (box.Empty())
+            continue;
+        bool overlaps = true;
+        for (int axis = 0; axis < 3; ++axis)
+            overlaps = overlaps && box.Min[axis] <= query.Max[axis] && box.Max[axis] >= query.Min[axis];
+        if (overlaps)
+            count++;
+    }
+    return count;
+}
+
+// Counts the non-empty boxes the BVH and the brute force frustum test disagree on
+static int compareFrustum(const BoundsArray& bounds, const BVH& bvh, const glm::vec4* planes)
+{
+    std::vector<GLubyte> expected, actual;
+    bounds.CullFrustum(planes, expected);
+    bvh.CullFrustum(planes, actual);
+    int mismatches = 0;
+    for (size_t i = 0; i < bounds.Size(); ++i) {
+        if (!bounds.Get(i).Empty() && expected[i] != actual[i])
+            mismatches++;
+    }
+    return mismatches;
+}
+
+// Planes of an axis aligned box around center, inside is where dot(plane, (p, 1)) >= 0
+static void boxPlanes(const glm::vec3& center, GLfloat halfSize, glm::vec4 planes[6])
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        glm::vec4 plane(0.0f);
+        plane[axis] = 1.0f;
+        plane.w = halfSize - center[axis];
+        planes[axis * 2] = plane;
+        plane[axis] = -1.0f;
+        plane.w = halfSize + center[axis];
+        planes[axis * 2 + 1] = plane;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    unsigned seed = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc)
+            seed = (unsigned)atoi(argv[++i]);
+        else {
+            std::cout << "Usage: " << argv[0] << " [--seed N]\n";
+            return 1;
+        }
+    }
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<GLfloat> position(-10.0f, 10.0f), extent(0.01f, 1.0f);
+    const int QUERIES = 200;
+
+    int failed = 0;
+    for (int objects : { 0, 1, 3, 5, 37, 2000 }) {
+        // Random boxes, every 17th one empty like an object without geometry
+        BoundsArray bounds;
+        for (int i = 0; i < objects; ++i) {
+            AABB box;
+            if (i % 17 != 3) {
+                glm::vec3 corner(position(rng), position(rng), position(rng));
+                box.Add(corner);
+                box.Add(corner + glm::vec3(extent(rng), extent(rng), extent(rng)));
+            }
+            bounds.Add(box);
+        }
+        BVH bvh;
+        bvh.Build(bounds);
+
+        int frustumMismatches = 0, rayMismatches = 0, overlapMismatches = 0;
+        for (int q = 0; q < QUERIES; ++q) {
+            glm::vec4 planes[6];
+            boxPlanes(glm::vec3(position(rng), position(rng), position(rng)), extent(rng) * 8.0f, planes);
+            frustumMismatches += compareFrustum(bounds, bvh, planes);
+
+            glm::vec3 origin(position(rng), position(rng), position(rng));
+            glm::vec3 direction = glm::normalize(glm::vec3(position(rng), position(rng), position(rng)));
+            GLfloat expectedDistance, actualDistance;
+            GLint expected = raycastAll(bounds, origin, direction, 100.0f, expectedDistance);
+            GLint actual = bvh.Raycast(origin, direction, 100.0f, actualDistance);
+            // Boxes hit at the same distance may come back in either order
+            if (expected != actual && !(expected >= 0 && actual >= 0 && std::abs(expectedDistance - actualDistance) < 1e-5f))
+                rayMismatches++;
+
+            AABB query;
+            query.Add(origin);
+            query.Add(origin + glm::vec3(3.0f));
+            std::vector<GLuint> overlapping;
+            bvh.Overlap(query, overlapping);
+            if (overlapping.size() != overlapAll(bounds, query))
+                overlapMismatches++;
+        }
+
+        // Move some objects, then check both the per object update and a full refit
+        for (int i = 0; i < objects; i += 7) {
+            AABB box = bounds.Get(i);
+            if (box.Empty())
+                continue;
+            box.Min.x += 1.0f;
+            box.Max.x += 1.0f;
+            bounds.Set(i, box);
+            bvh.Update(i, box);
+        }
+        glm::vec4 planes[6];
+        boxPlanes(glm::vec3(0.0f), 5.0f, planes);
+        int refitMismatches = compareFrustum(bounds, bvh, planes);
+        bvh.Refit(bounds);
+        refitMismatches += compareFrustum(bounds, bvh, planes);
+
+        int mismatches = frustumMismatches + rayMismatches + overlapMismatches + refitMismatches;
+        std::cout << objects << " boxes, " << bvh.NodeCount() << " nodes: " << (mismatches ? "FAILED" : "ok")
+                  << " (frustum " << frustumMismatches << ", ray " << rayMismatches << ", overlap "
+                  << overlapMismatches << ", refit " << refitMismatches << " mismatches)\n";
+        if (mismatches)
+            failed++;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,76 @@
+// ======================================================
+// Texture cooker
+// Converts source images into the compressed texture cache read by basic.cpp and test.cpp
+// Usage: ./cook [--cache DIR] [--size N] image...
+// ======================================================
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+
+#include "TextureCache.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+
+int main(int argc, char** argv)
+{
+    std::string cacheDir = "texture_cache";
+    int size = TextureCache::LAYER_SIZE; // entries at any other size are resampled again on load
+    std::vector<std::string> images;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--cache" && i + 1 < argc)
+            cacheDir = argv[++i];
+        else if (arg == "--size" && i + 1 < argc)
+            size = std::max(1, atoi(argv[++i]));
+        else
+            images.push_back(arg);
+    }
+    if (images.empty()) {
+        std::cout << "Usage: " << argv[0] << " [--cache DIR] [--size N] image...\n";
+        return 1;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(cacheDir, error);
+
+    int failed = 0;
+    for (const std::string& path : images) {
+        std::vector<unsigned char> bytes;
+        if (!TextureCache::ReadFile(path, bytes)) {
+            std::cerr << "Failed to read " << path << std::endl;
+            failed++;
+            continue;
+        }
+
+        int width, height, components;
+        unsigned char* pixels = stbi_load_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &components, 4);
+        if (!pixels) {
+            std::cerr << "Failed to decode " << path << ": " << stbi_failure_reason() << std::endl;
+            failed++;
+            continue;
+        }
+        std::vector<unsigned char> resized = TextureCache::Resize(pixels, width, height, size, size);
+        stbi_image_free(pixels);
+        CachedTexture texture = TextureCache::Cook(resized.data(), size, size, TextureCache::Opaque(resized.data(), size, size));
+
+        std::string entry = TextureCache::EntryPath(cacheDir, TextureCache::ContentHash(bytes));
+        if (!TextureCache::Write(entry, texture)) {
+            std::cerr << "Failed to write " << entry << std::endl;
+            failed++;
+            continue;
+        }
+
+        size_t bytesWritten = 0;
+        for (const TextureLevel& level : texture.Levels)
+            bytesWritten += level.Data.size();
+        std::cout << path << " -> " << entry << " (" << size << "x" << size << ", "
+                  << texture.Levels.size() << " levels, " << (texture.Compressed ? "BC1" : "RGBA8") << ", "
+                  << bytesWritten << " bytes)\n";
+    }
+    return failed ? 1 : 0;
+}
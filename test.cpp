@@ -11,7 +11,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-// STB_IMAGE_IMPLEMENTATION should be defined in exactly one .cpp file
+#include "TextureLoader.h"
+
+// STB_IMAGE_IMPLEMENTATION should be defined in exactly one .cpp file, after every header including stb_image.h
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -24,8 +26,6 @@ glm::vec3 cameraTarget = glm::vec3(0.0f, 0.0f, 0.0f);
 glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
 
 // No animation, keeping the prism static
-// Function prototypes
-GLuint loadTexture(const char* path);
 
 // Camera view matrix will be static
 
@@ -90,11 +90,11 @@ int main() {
         
         out vec4 color;
         
-        uniform sampler2D ourTexture;
+        uniform sampler2DArray ourTexture;
         
         void main()
         {   
-            color = texture(ourTexture, TexCoord);
+            color = texture(ourTexture, vec3(TexCoord, 0.0));
         }
     )";
 
@@ -207,18 +207,25 @@ int main() {
 
     glBindVertexArray(0); // Unbind VAO
 
-    // Load and create a texture
-    GLuint texture = loadTexture("kleenex-box.jpg");
-    if (texture == 0) {
-        std::cerr << "Failed to load texture" << std::endl;
-        return -1;
-    }
+    // Load the texture on a worker thread, the prism is drawn grey until it has been uploaded
+    TextureLoader textureLoader(1);
+    textureLoader.Load("kleenex-box.jpg", glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+
+    // Get the uniform locations once instead of every frame
+    GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
+    GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
+    GLint projLoc = glGetUniformLocation(shaderProgram, "projection");
+    glUseProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "ourTexture"), 0);
 
     // Main rendering loop
     while (!glfwWindowShouldClose(window)) {
         // Check for events
         glfwPollEvents();
 
+        // Upload the texture once it has been decoded
+        textureLoader.Update();
+
         // Clear the screen
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -234,20 +241,13 @@ int main() {
         // Static rotation (no animation)
         model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.5f, 1.0f, 0.0f));
 
-        // Get their uniform locations
-        GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-        GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
-        GLint projLoc = glGetUniformLocation(shaderProgram, "projection");
-        
         // Pass them to the shaders
         glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
         glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
         glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
 
         // Bind Texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glUniform1i(glGetUniformLocation(shaderProgram, "ourTexture"), 0);
+        textureLoader.Bind(0);
 
         // Render the cube
         glBindVertexArray(VAO);
@@ -261,47 +261,11 @@ int main() {
     // Properly de-allocate all resources
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
+    textureLoader.Release();
     
     // Terminate GLFW, clearing any resources allocated by GLFW
     glfwTerminate();
     return 0;
 }
 
-// Load a texture from file
-GLuint loadTexture(const char* path) {
-    // Generate texture ID and load texture data
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        // Set texture parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    } else {
-        std::cerr << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-        return 0;
-    }
-
-    return textureID;
-}
-
 // All movement functions have been removed